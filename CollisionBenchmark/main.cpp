@@ -0,0 +1,528 @@
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <cmath>
+
+#include <PirateShip/entity.h>
+#include <PirateShip/crowd.h>
+#include <PirateShip/thread_pool.h>
+
+// Headless benchmark of the collision broad-phase against the linear triangle scan
+
+// Count every heap allocation, so the steady-state collision path can be checked for none
+std::atomic<unsigned long long> allocationCount(0);
+
+void* operator new(size_t size)
+{
+	allocationCount++;
+	if (void* memory = malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+// GCC would inline these into the callers and then warn that free() gets a pointer from operator new
+#if defined(__GNUC__)
+#define ALLOCATION_COUNTER_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATION_COUNTER_NOINLINE
+#endif
+
+ALLOCATION_COUNTER_NOINLINE void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+ALLOCATION_COUNTER_NOINLINE void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+struct Query {
+	glm::vec3 position;
+	glm::vec3 velocity;
+};
+
+struct Result {
+	bool foundCollision;
+	double nearestDistance;
+	glm::vec3 intersectionPoint;
+};
+
+std::shared_ptr<CollisionWorld> makeTerrain(unsigned int cellsPerSide);
+std::shared_ptr<CollisionWorld> makeTriangleSoup(unsigned int count, std::mt19937& rng);
+std::vector<Query> makeQueries(unsigned int count, float worldSize);
+Result runQuery(CharacterEntity& entity, const Query& query, BroadPhase broadPhase, SimdIsa isa);
+bool sameResult(const Result& a, const Result& b, float tolerance = 0.0f);
+const char* isaName(SimdIsa isa);
+
+void benchmarkBroadPhase();
+void benchmarkGrid();
+void benchmarkNarrowPhase();
+void benchmarkPlaneCache();
+void fuzzNarrowPhase();
+void countAllocations();
+void benchmarkCrowd();
+
+
+int main()
+{
+	std::cout << "Narrow-phase dispatch: " << isaName(SimdMath::bestIsa()) << std::endl << std::endl;
+
+	benchmarkBroadPhase();
+	benchmarkGrid();
+	benchmarkNarrowPhase();
+	benchmarkPlaneCache();
+	fuzzNarrowPhase();
+	countAllocations();
+	benchmarkCrowd();
+
+	return 0;
+}
+
+
+// Linear scan against the BVH, both with the scalar narrow-phase so results must match exactly
+void benchmarkBroadPhase()
+{
+	const unsigned int queryCount = 2000;
+	const unsigned int sizes[] = { 16, 32, 64, 128, 256 };
+
+	std::cout << "Broad-phase" << std::endl;
+	std::cout << std::setw(12) << "triangles"
+		<< std::setw(16) << "linear ns/q"
+		<< std::setw(16) << "bvh ns/q"
+		<< std::setw(12) << "speedup"
+		<< std::setw(12) << "mismatches" << std::endl;
+
+	for (unsigned int cellsPerSide : sizes) {
+		CharacterEntity entity;
+		entity.setWorld(makeTerrain(cellsPerSide));
+		std::vector<Query> queries = makeQueries(queryCount, cellsPerSide * 0.5f);
+
+		std::vector<Result> linearResults(queries.size());
+		std::vector<Result> bvhResults(queries.size());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < queries.size(); i++)
+			linearResults[i] = runQuery(entity, queries[i], BROAD_PHASE_LINEAR, SIMD_SCALAR);
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < queries.size(); i++)
+			bvhResults[i] = runQuery(entity, queries[i], BROAD_PHASE_BVH, SIMD_SCALAR);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		unsigned int mismatches = 0;
+		for (unsigned int i = 0; i < queries.size(); i++) {
+			if (!sameResult(linearResults[i], bvhResults[i]))
+				mismatches++;
+		}
+
+		double linearNs = std::chrono::duration<double, std::nano>(middle - start).count() / queries.size();
+		double bvhNs = std::chrono::duration<double, std::nano>(end - middle).count() / queries.size();
+
+		std::cout << std::setw(12) << entity.world->triangles.size()
+			<< std::setw(16) << std::fixed << std::setprecision(1) << linearNs
+			<< std::setw(16) << bvhNs
+			<< std::setw(12) << std::setprecision(2) << linearNs / bvhNs
+			<< std::setw(12) << mismatches << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+
+// Linear scan against the uniform grid at several cell sizes, on a large flat world
+void benchmarkGrid()
+{
+	const unsigned int queryCount = 2000;
+	const unsigned int cellsPerSide = 256;
+	const float cellSizes[] = { 0.5f, 1.0f, 2.0f, 4.0f, 8.0f };
+
+	CharacterEntity entity;
+	entity.setWorld(makeTerrain(cellsPerSide));
+	std::shared_ptr<CollisionWorld> world = entity.world;
+	std::vector<Query> queries = makeQueries(queryCount, cellsPerSide * 0.5f);
+
+	std::vector<Result> linearResults(queries.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < queries.size(); i++)
+		linearResults[i] = runQuery(entity, queries[i], BROAD_PHASE_LINEAR, SIMD_SCALAR);
+	auto end = std::chrono::high_resolution_clock::now();
+	double linearNs = std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+
+	std::cout << "Grid, " << world->triangles.size() << " triangles, linear scan " << std::setprecision(1) << linearNs << " ns/q" << std::endl;
+	std::cout << std::setw(12) << "cell size"
+		<< std::setw(16) << "build ms"
+		<< std::setw(16) << "grid ns/q"
+		<< std::setw(12) << "speedup"
+		<< std::setw(12) << "mismatches" << std::endl;
+
+	for (float cellSize : cellSizes) {
+		auto buildStart = std::chrono::high_resolution_clock::now();
+		world->setGridCellSize(cellSize);
+		world->update();
+		auto buildEnd = std::chrono::high_resolution_clock::now();
+
+		std::vector<Result> gridResults(queries.size());
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < queries.size(); i++)
+			gridResults[i] = runQuery(entity, queries[i], BROAD_PHASE_GRID, SIMD_SCALAR);
+		end = std::chrono::high_resolution_clock::now();
+
+		unsigned int mismatches = 0;
+		for (unsigned int i = 0; i < queries.size(); i++) {
+			if (!sameResult(linearResults[i], gridResults[i]))
+				mismatches++;
+		}
+
+		double buildMs = std::chrono::duration<double, std::milli>(buildEnd - buildStart).count();
+		double gridNs = std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+
+		std::cout << std::setw(12) << std::setprecision(1) << cellSize
+			<< std::setw(16) << std::setprecision(2) << buildMs
+			<< std::setw(16) << std::setprecision(1) << gridNs
+			<< std::setw(12) << std::setprecision(2) << linearNs / gridNs
+			<< std::setw(12) << mismatches << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+
+// Every instruction set over the whole triangle list, no broad-phase
+void benchmarkNarrowPhase()
+{
+	const unsigned int queryCount = 500;
+	const unsigned int cellsPerSide = 64;
+	const SimdIsa isas[] = { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 };
+
+	CharacterEntity entity;
+	entity.setWorld(makeTerrain(cellsPerSide));
+	entity.broadPhase = BROAD_PHASE_LINEAR;
+	std::vector<Query> queries = makeQueries(queryCount, cellsPerSide * 0.5f);
+
+	// Index list covering every triangle
+	std::vector<unsigned int> all(entity.world->triangles.size());
+	for (unsigned int i = 0; i < all.size(); i++)
+		all[i] = i;
+
+	std::cout << "Narrow-phase, " << all.size() << " triangles" << std::endl;
+	std::cout << std::setw(12) << "isa" << std::setw(16) << "ns/triangle" << std::setw(12) << "speedup" << std::endl;
+
+	double scalarNs = 0.0;
+	for (SimdIsa isa : isas) {
+		if (isa > SimdMath::bestIsa())
+			continue;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const Query& query : queries) {
+			CollisionPackage& package = *entity.collisionPackage;
+			package.velocity = query.velocity;
+			package.normalizedVelocity = glm::normalize(query.velocity);
+			package.basePoint = query.position;
+			package.foundCollision = false;
+			SimdMath::checkTriangles(entity.collisionPackage, *entity.world, all.data(), (unsigned int)all.size(), isa);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double ns = std::chrono::duration<double, std::nano>(end - start).count() / ((double)queries.size() * all.size());
+		if (isa == SIMD_SCALAR)
+			scalarNs = ns;
+
+		std::cout << std::setw(12) << isaName(isa)
+			<< std::setw(16) << std::setprecision(2) << ns
+			<< std::setw(12) << scalarNs / ns << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+
+// Scalar narrow-phase building each triangle's plane per query against reading the world's cached planes
+void benchmarkPlaneCache()
+{
+	const unsigned int queryCount = 500;
+	const unsigned int cellsPerSide = 64;
+
+	std::shared_ptr<CollisionWorld> world = makeTerrain(cellsPerSide);
+	std::vector<Query> queries = makeQueries(queryCount, cellsPerSide * 0.5f);
+	std::unique_ptr<CollisionPackage> package = std::make_unique<CollisionPackage>();
+
+	double ns[2];
+	std::vector<Result> results[2];
+	for (int cached = 0; cached < 2; cached++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const Query& query : queries) {
+			package->velocity = query.velocity;
+			package->normalizedVelocity = glm::normalize(query.velocity);
+			package->basePoint = query.position;
+			package->foundCollision = false;
+
+			for (const CollisionTriangle& triangle : world->triangles) {
+				if (cached)
+					Math::checkTriangle(package, triangle);
+				else
+					Math::checkTriangle(package, triangle.p1, triangle.p2, triangle.p3);
+			}
+			results[cached].push_back(Result{ package->foundCollision, package->nearestDistance, package->intersectionPoint });
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		ns[cached] = std::chrono::duration<double, std::nano>(end - start).count() / ((double)queries.size() * world->triangles.size());
+	}
+
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < queries.size(); i++) {
+		if (!sameResult(results[0][i], results[1][i]))
+			mismatches++;
+	}
+
+	std::cout << "Plane cache, " << world->triangles.size() << " triangles" << std::endl;
+	std::cout << std::setw(12) << "planes" << std::setw(16) << "ns/triangle" << std::setw(12) << "speedup" << std::endl;
+	std::cout << std::setw(12) << "per query" << std::setw(16) << std::setprecision(2) << ns[0] << std::setw(12) << 1.0 << std::endl;
+	std::cout << std::setw(12) << "cached" << std::setw(16) << ns[1] << std::setw(12) << ns[0] / ns[1] << std::endl;
+	std::cout << std::setw(12) << "mismatches" << std::setw(16) << mismatches << std::endl << std::endl;
+}
+
+
+// Random triangle soups through every instruction set, compared against the scalar reference
+void fuzzNarrowPhase()
+{
+	const unsigned int rounds = 200;
+	const unsigned int trianglesPerRound = 61;
+	const unsigned int queriesPerRound = 50;
+	// Lanes run in single precision where the reference mixes in doubles
+	const float tolerance = 1e-3f;
+	const SimdIsa isas[] = { SIMD_SSE, SIMD_AVX2 };
+
+	std::mt19937 rng(42);
+	unsigned int tested = 0, hits = 0;
+	unsigned int mismatches[3] = { 0, 0, 0 };
+
+	for (unsigned int round = 0; round < rounds; round++) {
+		CharacterEntity entity;
+		entity.setWorld(makeTriangleSoup(trianglesPerRound, rng));
+		std::vector<Query> queries = makeQueries(queriesPerRound, 8.0f);
+
+		for (const Query& query : queries) {
+			Result reference = runQuery(entity, query, BROAD_PHASE_BVH, SIMD_SCALAR);
+			tested++;
+			if (reference.foundCollision)
+				hits++;
+
+			for (SimdIsa isa : isas) {
+				if (isa > SimdMath::bestIsa())
+					continue;
+				if (!sameResult(reference, runQuery(entity, query, BROAD_PHASE_BVH, isa), tolerance))
+					mismatches[isa]++;
+			}
+		}
+	}
+
+	std::cout << "Fuzz, " << tested << " queries (" << hits << " hits) against the scalar reference" << std::endl;
+	for (SimdIsa isa : isas) {
+		if (isa <= SimdMath::bestIsa())
+			std::cout << std::setw(12) << isaName(isa) << std::setw(12) << mismatches[isa] << " mismatches" << std::endl;
+	}
+}
+
+
+// Run the per-frame collision work main.cpp does and count heap allocations once warmed up
+void countAllocations()
+{
+	const unsigned int warmUpFrames = 10;
+	const unsigned int frames = 1000;
+
+	std::shared_ptr<CollisionWorld> world = makeTerrain(64);
+	CharacterEntity entity;
+	entity.setWorld(world);
+	entity.position = glm::vec3(16.0f, 2.0f, 16.0f);
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> direction(-0.2f, 0.2f);
+	unsigned long long before = 0;
+
+	for (unsigned int frame = 0; frame < warmUpFrames + frames; frame++) {
+		if (frame == warmUpFrames)
+			before = allocationCount;
+
+		world->setTransform(0, glm::mat4(1.0f));
+		world->setRadius(glm::vec3(1.0f));
+		world->update();
+
+		entity.velocity += glm::vec3(direction(rng), 0.0f, direction(rng));
+		entity.update(true);
+		entity.velocity = entity.velocity * .05f;
+	}
+
+	std::cout << std::endl << "Allocations over " << frames << " steady-state frames: " << allocationCount - before << std::endl;
+}
+
+
+// Crowd throughput as threads are added, positions must not depend on the thread count
+void benchmarkCrowd()
+{
+	const unsigned int entityCount = 1024;
+	const unsigned int frames = 20;
+	const unsigned int maxThreads = ThreadPool::defaultWorkerCount() + 1;
+
+	std::shared_ptr<CollisionWorld> world = makeTerrain(128);
+
+	std::cout << std::endl << "Crowd of " << entityCount << " entities, " << world->triangles.size() << " triangles" << std::endl;
+	std::cout << std::setw(12) << "threads" << std::setw(16) << "entities/ms" << std::setw(12) << "scaling" << std::setw(12) << "mismatches" << std::endl;
+
+	double singleThreaded = 0.0;
+	std::vector<glm::vec3> reference;
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+		ThreadPool pool(threads - 1);
+		Crowd crowd(world);
+
+		std::mt19937 rng(99);
+		std::uniform_real_distribution<float> across(0.0f, 64.0f);
+		std::uniform_real_distribution<float> direction(-0.3f, 0.3f);
+		for (unsigned int i = 0; i < entityCount; i++) {
+			std::shared_ptr<CharacterEntity> entity = crowd.spawn(glm::vec3(across(rng), 2.0f, across(rng)));
+			entity->velocity = glm::vec3(direction(rng), 0.0f, direction(rng));
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++)
+			crowd.update(pool, true);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		unsigned int mismatches = 0;
+		for (unsigned int i = 0; i < entityCount; i++) {
+			if (threads == 1)
+				reference.push_back(crowd.entities[i]->position);
+			else if (crowd.entities[i]->position != reference[i])
+				mismatches++;
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		double throughput = entityCount * frames / ms;
+		if (threads == 1)
+			singleThreaded = throughput;
+
+		std::cout << std::setw(12) << threads
+			<< std::setw(16) << std::setprecision(1) << throughput
+			<< std::setw(12) << std::setprecision(2) << throughput / singleThreaded
+			<< std::setw(12) << mismatches << std::endl;
+	}
+}
+
+
+// Bumpy height field of 2 * cellsPerSide^2 triangles, with a unit radius so R3 is ellipsoid space
+std::shared_ptr<CollisionWorld> makeTerrain(unsigned int cellsPerSide)
+{
+	const float cellSize = 0.5f;
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+
+	auto height = [](float x, float z) {
+		return 0.5f * sin(x * 0.7f) * cos(z * 0.4f);
+	};
+
+	for (unsigned int i = 0; i < cellsPerSide; i++) {
+		for (unsigned int j = 0; j < cellsPerSide; j++) {
+			float x0 = i * cellSize, x1 = (i + 1) * cellSize;
+			float z0 = j * cellSize, z1 = (j + 1) * cellSize;
+			glm::vec3 a(x0, height(x0, z0), z0);
+			glm::vec3 b(x1, height(x1, z0), z0);
+			glm::vec3 c(x1, height(x1, z1), z1);
+			glm::vec3 d(x0, height(x0, z1), z1);
+			unsigned int first = (unsigned int)positions.size();
+			positions.insert(positions.end(), { a, b, c, d });
+			// Wound so the normals face up
+			indices.insert(indices.end(), { first, first + 2, first + 1 });
+			indices.insert(indices.end(), { first, first + 3, first + 2 });
+		}
+	}
+
+	std::shared_ptr<CollisionWorld> world = std::make_shared<CollisionWorld>();
+	world->addHitbox(positions, indices);
+	world->update();
+	return world;
+}
+
+
+// Randomly placed and oriented triangles filling a small box
+std::shared_ptr<CollisionWorld> makeTriangleSoup(unsigned int count, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> across(0.0f, 8.0f);
+	std::uniform_real_distribution<float> offset(-1.5f, 1.5f);
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+
+	for (unsigned int i = 0; i < count; i++) {
+		glm::vec3 corner(across(rng), across(rng) * 0.5f, across(rng));
+		positions.push_back(corner);
+		positions.push_back(corner + glm::vec3(offset(rng), offset(rng), offset(rng)));
+		positions.push_back(corner + glm::vec3(offset(rng), offset(rng), offset(rng)));
+		indices.insert(indices.end(), { 3 * i, 3 * i + 1, 3 * i + 2 });
+	}
+
+	std::shared_ptr<CollisionWorld> world = std::make_shared<CollisionWorld>();
+	world->addHitbox(positions, indices);
+	world->update();
+	return world;
+}
+
+
+// Spheres hovering just above the terrain moving in random directions
+std::vector<Query> makeQueries(unsigned int count, float worldSize)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> across(0.0f, worldSize);
+	std::uniform_real_distribution<float> above(0.5f, 2.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+	std::vector<Query> queries;
+	for (unsigned int i = 0; i < count; i++) {
+		Query query;
+		query.position = glm::vec3(across(rng), above(rng), across(rng));
+		query.velocity = glm::vec3(direction(rng), direction(rng) - 0.5f, direction(rng));
+		queries.push_back(query);
+	}
+
+	return queries;
+}
+
+
+// Set up the collision package the same way collideWithWorld does and run a single check
+Result runQuery(CharacterEntity& entity, const Query& query, BroadPhase broadPhase, SimdIsa isa)
+{
+	CollisionPackage& package = *entity.collisionPackage;
+	package.velocity = query.velocity;
+	package.normalizedVelocity = glm::normalize(query.velocity);
+	package.basePoint = query.position;
+	package.foundCollision = false;
+
+	entity.broadPhase = broadPhase;
+	entity.simdIsa = isa;
+	entity.checkCollision();
+
+	return Result{ package.foundCollision, package.nearestDistance, package.intersectionPoint };
+}
+
+
+bool sameResult(const Result& a, const Result& b, float tolerance)
+{
+	if (a.foundCollision != b.foundCollision)
+		return false;
+	if (!a.foundCollision)
+		return true;
+	return fabs(a.nearestDistance - b.nearestDistance) <= tolerance &&
+		glm::length(a.intersectionPoint - b.intersectionPoint) <= tolerance;
+}
+
+
+const char* isaName(SimdIsa isa)
+{
+	switch (isa) {
+	case SIMD_AVX2: return "avx2";
+	case SIMD_SSE: return "sse";
+	default: return "scalar";
+	}
+}
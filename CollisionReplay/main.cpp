@@ -0,0 +1,363 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <PirateShip/collision_world.h>
+#include <PirateShip/entity.h>
+#include <PirateShip/physics.h>
+
+// Headless replay of player movement against a hitbox mesh, no window or GL context needed.
+//
+// CollisionReplay [options]
+//   --mesh <file.obj>          hitbox to collide against (resources/hitbox/hitbox.obj)
+//   --velocities <file>        replay recorded input, one "vx vy vz gravity" line per step
+//   --steps <n> --seed <n>     otherwise generate n steps of wandering input (2000, 1)
+//   --save-velocities <file>   write the input that was replayed
+//   --golden <file>            compare every step's position against a trace, exit 1 if it differs
+//   --write-golden <file>      record the positions as the new trace
+//   --tolerance <f>            allowed distance from the golden trace (0)
+//   --broad-phase <linear|bvh|grid>  --cell-size <f>  --isa <scalar|sse|avx2>
+
+struct Step {
+	glm::vec3 velocity;
+	bool gravity;
+};
+
+struct Options {
+	std::string mesh = "resources/hitbox/hitbox.obj";
+	std::string velocities;
+	std::string saveVelocities;
+	std::string golden;
+	std::string writeGolden;
+	unsigned int steps = 2000;
+	unsigned int seed = 1;
+	float tolerance = 0.0f;
+	float cellSize = 2.0f;
+	BroadPhase broadPhase = BROAD_PHASE_BVH;
+	SimdIsa isa = SimdMath::bestIsa();
+};
+
+bool parseOptions(int argc, char** argv, Options& options);
+bool loadObj(const std::string& path, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices);
+bool loadSteps(const std::string& path, std::vector<Step>& steps);
+bool saveSteps(const std::string& path, const std::vector<Step>& steps);
+bool loadTrace(const std::string& path, std::vector<glm::vec3>& trace);
+bool saveTrace(const std::string& path, const std::vector<glm::vec3>& trace);
+std::vector<Step> generateSteps(unsigned int count, unsigned int seed);
+double ratio(double total, double count);
+
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+		return 2;
+
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+	if (!loadObj(options.mesh, positions, indices))
+		return 2;
+
+	std::vector<Step> steps;
+	if (!options.velocities.empty()) {
+		if (!loadSteps(options.velocities, steps))
+			return 2;
+	}
+	else {
+		steps = generateSteps(options.steps, options.seed);
+	}
+	if (steps.empty()) {
+		std::cout << "ERROR::REPLAY::NO_STEPS" << std::endl;
+		return 2;
+	}
+	if (!options.saveVelocities.empty() && !saveSteps(options.saveVelocities, steps))
+		return 2;
+
+	// Same player and hitbox placement as main.cpp
+	std::shared_ptr<CharacterEntity> entity = std::make_shared<CharacterEntity>();
+	entity->position = glm::vec3(0.0f, 7.0f, 4.0f);
+	entity->broadPhase = options.broadPhase;
+	entity->simdIsa = options.isa;
+
+	glm::mat4 hitboxModel = glm::mat4(1.0f);
+	hitboxModel = glm::translate(hitboxModel, glm::vec3(0.0f, 5.0f, 0.0f));
+	hitboxModel = glm::scale(hitboxModel, glm::vec3(200, 200, 200));
+
+	std::shared_ptr<CollisionWorld> world = std::make_shared<CollisionWorld>();
+	world->addHitbox(positions, indices, hitboxModel);
+	world->setRadius(entity->collisionPackage->eRadius);
+	if (options.broadPhase == BROAD_PHASE_GRID)
+		world->setGridCellSize(options.cellSize);
+	world->update();
+	entity->setWorld(world);
+
+	std::vector<glm::vec3> trace;
+	trace.reserve(steps.size());
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (const Step& step : steps) {
+		PhysicsThread::step(*entity, step.velocity, step.gravity);
+		trace.push_back(entity->position);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	const CollisionStats& stats = entity->stats;
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	unsigned long long slides = 0;
+	for (unsigned long long count : stats.depthHistogram)
+		slides += count;
+
+	std::cout << "Replayed " << steps.size() << " steps against " << world->triangles.size() << " triangles" << std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "  ns/step            " << ratio(ns, (double)steps.size()) << std::endl;
+	std::cout << "  ns/query           " << ratio(ns, (double)stats.queries) << std::endl;
+	std::cout << "  queries/step       " << ratio((double)stats.queries, (double)steps.size()) << std::endl;
+	std::cout << "  triangles/query    " << ratio((double)stats.trianglesTested, (double)stats.queries) << std::endl;
+	std::cout << "Recursion depth" << std::endl;
+	for (int depth = 0; depth <= CollisionStats::maxRecursionDepth; depth++) {
+		std::cout << std::setw(4) << depth << (depth == CollisionStats::maxRecursionDepth ? "+" : " ")
+			<< std::setw(10) << stats.depthHistogram[depth]
+			<< std::setw(8) << 100.0 * ratio((double)stats.depthHistogram[depth], (double)slides) << "%" << std::endl;
+	}
+	std::cout << "Final position       " << std::setprecision(5)
+		<< trace.back().x << " " << trace.back().y << " " << trace.back().z << std::endl;
+
+	if (!options.writeGolden.empty() && !saveTrace(options.writeGolden, trace))
+		return 2;
+
+	if (!options.golden.empty()) {
+		std::vector<glm::vec3> golden;
+		if (!loadTrace(options.golden, golden))
+			return 2;
+		if (golden.size() != trace.size()) {
+			std::cout << "Golden trace has " << golden.size() << " steps, replay has " << trace.size() << std::endl;
+			return 1;
+		}
+
+		unsigned int mismatches = 0;
+		size_t firstMismatch = 0;
+		float worst = 0.0f;
+		for (size_t i = 0; i < trace.size(); i++) {
+			float distance = glm::length(trace[i] - golden[i]);
+			if (distance > options.tolerance) {
+				if (mismatches == 0)
+					firstMismatch = i;
+				mismatches++;
+			}
+			if (distance > worst)
+				worst = distance;
+		}
+
+		std::cout << "Golden trace         " << mismatches << " mismatching steps, worst " << std::scientific << worst << std::endl;
+		if (mismatches > 0) {
+			std::cout << "  first at step " << firstMismatch << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (i + 1 >= argc) {
+			std::cout << "ERROR::REPLAY::MISSING_VALUE " << option << std::endl;
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if (option == "--mesh") options.mesh = value;
+		else if (option == "--velocities") options.velocities = value;
+		else if (option == "--save-velocities") options.saveVelocities = value;
+		else if (option == "--golden") options.golden = value;
+		else if (option == "--write-golden") options.writeGolden = value;
+		else if (option == "--steps") options.steps = (unsigned int)atoi(value.c_str());
+		else if (option == "--seed") options.seed = (unsigned int)atoi(value.c_str());
+		else if (option == "--tolerance") options.tolerance = (float)atof(value.c_str());
+		else if (option == "--cell-size") options.cellSize = (float)atof(value.c_str());
+		else if (option == "--broad-phase") {
+			if (value == "linear") options.broadPhase = BROAD_PHASE_LINEAR;
+			else if (value == "bvh") options.broadPhase = BROAD_PHASE_BVH;
+			else if (value == "grid") options.broadPhase = BROAD_PHASE_GRID;
+			else {
+				std::cout << "ERROR::REPLAY::UNKNOWN_BROAD_PHASE " << value << std::endl;
+				return false;
+			}
+		}
+		else if (option == "--isa") {
+			if (value == "scalar") options.isa = SIMD_SCALAR;
+			else if (value == "sse") options.isa = SIMD_SSE;
+			else if (value == "avx2") options.isa = SIMD_AVX2;
+			else {
+				std::cout << "ERROR::REPLAY::UNKNOWN_ISA " << value << std::endl;
+				return false;
+			}
+			if (options.isa > SimdMath::bestIsa()) {
+				std::cout << "ERROR::REPLAY::ISA_NOT_SUPPORTED " << value << std::endl;
+				return false;
+			}
+		}
+		else {
+			std::cout << "ERROR::REPLAY::UNKNOWN_OPTION " << option << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Positions and faces of a Wavefront OBJ, polygons fanned into triangles like aiProcess_Triangulate
+bool loadObj(const std::string& path, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::REPLAY::MESH_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v") {
+			glm::vec3 position;
+			stream >> position.x >> position.y >> position.z;
+			positions.push_back(position);
+		}
+		else if (type == "f") {
+			// Each corner is v, v/vt, v//vn or v/vt/vn, negative indices count back from the end
+			std::vector<unsigned int> corners;
+			std::string corner;
+			while (stream >> corner) {
+				int index = atoi(corner.c_str());
+				corners.push_back(index < 0 ? (unsigned int)((int)positions.size() + index) : (unsigned int)(index - 1));
+			}
+			for (size_t i = 1; i + 1 < corners.size(); i++)
+				indices.insert(indices.end(), { corners[0], corners[i], corners[i + 1] });
+		}
+	}
+
+	for (unsigned int index : indices) {
+		if (index >= positions.size()) {
+			std::cout << "ERROR::REPLAY::BAD_FACE_INDEX " << path << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool loadSteps(const std::string& path, std::vector<Step>& steps)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::REPLAY::VELOCITIES_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	Step step;
+	int gravity;
+	while (file >> step.velocity.x >> step.velocity.y >> step.velocity.z >> gravity) {
+		step.gravity = gravity != 0;
+		steps.push_back(step);
+	}
+	return true;
+}
+
+
+bool saveSteps(const std::string& path, const std::vector<Step>& steps)
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERROR::REPLAY::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+
+	file << std::setprecision(9);
+	for (const Step& step : steps)
+		file << step.velocity.x << " " << step.velocity.y << " " << step.velocity.z << " " << (step.gravity ? 1 : 0) << "\n";
+	return true;
+}
+
+
+bool loadTrace(const std::string& path, std::vector<glm::vec3>& trace)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::REPLAY::GOLDEN_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	glm::vec3 position;
+	while (file >> position.x >> position.y >> position.z)
+		trace.push_back(position);
+	return true;
+}
+
+
+// Nine significant digits round-trip a float exactly
+bool saveTrace(const std::string& path, const std::vector<glm::vec3>& trace)
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERROR::REPLAY::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+
+	file << std::setprecision(9);
+	for (const glm::vec3& position : trace)
+		file << position.x << " " << position.y << " " << position.z << "\n";
+	return true;
+}
+
+
+// A player walking the deck: WASD-sized pushes in a heading that wanders, with gravity now and then toggled off
+std::vector<Step> generateSteps(unsigned int count, unsigned int seed)
+{
+	// Camera SPEED times a 60 Hz frame
+	const float walkSpeed = 5.0f / 60.0f;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> turn(-0.3f, 0.3f);
+	std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+	std::vector<Step> steps;
+	float heading = 0.0f;
+	bool gravity = true;
+	bool walking = true;
+	for (unsigned int i = 0; i < count; i++) {
+		heading += turn(rng);
+		if (chance(rng) < 0.02f)
+			walking = !walking;
+		if (chance(rng) < 0.005f)
+			gravity = !gravity;
+
+		Step step;
+		step.velocity = walking ? glm::vec3(cos(heading), 0.0f, sin(heading)) * walkSpeed : glm::vec3(0.0f);
+		step.gravity = gravity;
+		steps.push_back(step);
+	}
+	return steps;
+}
+
+
+// total / count, 0 when nothing was counted
+double ratio(double total, double count)
+{
+	return count > 0.0 ? total / count : 0.0;
+}
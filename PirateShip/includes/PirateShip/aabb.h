@@ -0,0 +1,68 @@
+#pragma once
+#ifndef AABB_H
+#define AABB_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// Axis aligned bounding box
+class AABB
+{
+public:
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// An empty box that any point will expand
+	AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+	AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+	// Bounding box of a sphere moving from position along velocity
+	static AABB sweptSphere(const glm::vec3& position, const glm::vec3& velocity, float radius)
+	{
+		glm::vec3 end = position + velocity;
+		return AABB(glm::min(position, end) - radius, glm::max(position, end) + radius);
+	}
+
+	void expand(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void expand(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	bool overlaps(const AABB& other) const
+	{
+		return min.x <= other.max.x && max.x >= other.min.x &&
+			min.y <= other.max.y && max.y >= other.min.y &&
+			min.z <= other.max.z && max.z >= other.min.z;
+	}
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extent() const { return max - min; }
+	bool empty() const { return min.x > max.x; }
+
+	bool contains(const glm::vec3& point) const
+	{
+		return point.x >= min.x && point.x <= max.x &&
+			point.y >= min.y && point.y <= max.y &&
+			point.z >= min.z && point.z <= max.z;
+	}
+
+	// Box around this one after transform, each world axis' half extent summed over the box's axes
+	AABB transformed(const glm::mat4& transform) const
+	{
+		if (empty())
+			return *this;
+		glm::vec3 c = glm::vec3(transform * glm::vec4(center(), 1.0f));
+		glm::vec3 half = extent() * 0.5f;
+		glm::vec3 e = glm::abs(glm::vec3(transform[0])) * half.x + glm::abs(glm::vec3(transform[1])) * half.y + glm::abs(glm::vec3(transform[2])) * half.z;
+		return AABB(c - e, c + e);
+	}
+};
+#endif
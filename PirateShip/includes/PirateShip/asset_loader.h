@@ -0,0 +1,217 @@
+#pragma once
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <PirateShip/mesh_loader.h>
+#include <PirateShip/model.h>
+#include <PirateShip/texture.h>
+#include <PirateShip/texture_cache.h>
+#include <PirateShip/texture_compressor.h>
+#include <PirateShip/thread_pool.h>
+
+// Loads models and textures in the background. Workers read meshes (mesh cache or Assimp) and encode images,
+// then queue the GL uploads, which update() runs on the thread that owns the context. Handles are returned
+// straight away and fill in as their uploads run, so rendering can start before everything has arrived.
+class AssetLoader
+{
+public:
+	explicit AssetLoader(unsigned int workerCount = ThreadPool::defaultWorkerCount()) : pool(workerCount) {}
+
+	// The workers stop first, so none of them is still queuing an upload while the GL side goes
+	~AssetLoader()
+	{
+		pool.stop();
+		if (pixelUnpackBuffer != 0)
+			glDeleteBuffers(1, &pixelUnpackBuffer);
+	}
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// The meshes are read on one worker, then each texture the texture cache doesn't hold yet is encoded on a worker of
+	// its own. The last of them to finish queues the upload of the whole model.
+	std::shared_ptr<Model> loadModel(const std::string& path, GeometryRetention retention = RELEASE_GEOMETRY)
+	{
+		std::shared_ptr<Model> model = std::make_shared<Model>(retention);
+		std::shared_ptr<ModelJob> job = std::make_shared<ModelJob>();
+		job->path = path;
+		// Asked here, the workers can't query GL
+		job->compress = textureCompressionSupported();
+		outstanding++;
+
+		pool.submit([this, model, job]() {
+			job->read = MeshLoader::load(job->path, job->meshes, &job->fromCache);
+			complete([this, model, job]() {
+				if (job->read)
+					encodeTextures(model, job);
+				else
+					finishModel(model, job);
+			});
+		});
+		return model;
+	}
+
+	// The texture from the texture cache, read and encoded in the background if nothing holds it yet
+	TextureHandle loadTexture(const std::string& path, TextureRole role = TEXTURE_COLOR, bool flipVertically = true)
+	{
+		bool created;
+		TextureHandle texture = TextureCache::instance().acquire(path, role, flipVertically, created);
+		if (!created)
+			return texture;
+
+		std::shared_ptr<EncodedImage> image = std::make_shared<EncodedImage>();
+		bool compress = textureCompressionSupported();
+		outstanding++;
+
+		pool.submit([this, texture, image, path, role, flipVertically, compress]() {
+			bool read = loadEncodedImage(path, role, flipVertically, compress, *image);
+			complete([this, texture, image, path, read]() {
+				if (!read)
+					std::cout << "Texture failed to load at path: " << path << std::endl;
+				TextureCache::instance().fill(*texture, *image, pixelBuffer());
+			});
+		});
+		return texture;
+	}
+
+	// Run queued uploads on the GL thread, at least one and then more until budgetSeconds have passed
+	void update(double budgetSeconds = 0.002)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		do {
+			Upload upload;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (uploads.empty())
+					return;
+				upload = std::move(uploads.front());
+				uploads.pop_front();
+			}
+			upload();
+			outstanding--;
+		} while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < budgetSeconds);
+	}
+
+	// Upload on this thread as the workers finish, until the model has arrived
+	void wait(const Model& model)
+	{
+		while (!model.loaded) {
+			update(0.0);
+			std::this_thread::yield();
+		}
+	}
+
+	// Upload on this thread as the workers finish, until every asset has arrived
+	void finish()
+	{
+		while (!idle()) {
+			update(0.0);
+			std::this_thread::yield();
+		}
+	}
+
+	// Assets requested but not uploaded yet
+	unsigned int pending() const { return outstanding; }
+	bool idle() const { return outstanding == 0; }
+
+private:
+	typedef std::function<void()> Upload;
+
+	struct ModelJob {
+		std::string path;
+		std::vector<MeshData> meshes;
+		std::map<std::string, MaterialImage> images;	// keyed by Model::imageKey
+		std::atomic<unsigned int> encoding{ 0 };	// images still on a worker
+		bool compress = false;
+		bool fromCache = false;
+		bool read = false;
+	};
+
+	std::mutex mutex;
+	std::deque<Upload> uploads;
+	std::atomic<unsigned int> outstanding{ 0 };
+	unsigned int pixelUnpackBuffer = 0;
+	// Stopped by the destructor while the upload queue still exists. Uploads still queued then are dropped.
+	ThreadPool pool;
+
+	// On the GL thread once the meshes are read: take every material texture from the texture cache, so textures
+	// something else already holds are shared instead of read again, and hand the new ones out to the workers
+	void encodeTextures(const std::shared_ptr<Model>& model, const std::shared_ptr<ModelJob>& job)
+	{
+		std::string directory = job->path.substr(0, job->path.find_last_of('/'));
+		struct Encode {
+			std::string file;
+			TextureRole role;
+			MaterialImage* image;
+		};
+		std::vector<Encode> encode;
+		for (const MeshData& mesh : job->meshes) {
+			for (const Texture& texture : mesh.textures) {
+				std::string key = Model::imageKey(texture.type, texture.path);
+				if (job->images.find(key) != job->images.end())
+					continue;
+				MaterialImage& image = job->images[key];
+				Encode entry = { directory + '/' + texture.path, TextureCompressor::roleOf(texture.type), &image };
+				image.texture = TextureCache::instance().acquire(entry.file, entry.role, true, image.encode);
+				if (image.encode)
+					encode.push_back(entry);
+			}
+		}
+		if (encode.empty()) {
+			finishModel(model, job);
+			return;
+		}
+
+		// The images' entries stay where they are while the workers fill them, the map is complete
+		job->encoding = (unsigned int)encode.size();
+		outstanding++;
+		for (const Encode& entry : encode) {
+			pool.submit([this, model, job, entry]() {
+				MaterialImage& image = *entry.image;
+				image.read = loadEncodedImage(entry.file, entry.role, true, job->compress, image.image);
+				if (--job->encoding == 0)
+					complete([this, model, job]() { finishModel(model, job); });
+			});
+		}
+	}
+
+	// Upload the model's meshes and encoded textures, on the GL thread
+	void finishModel(const std::shared_ptr<Model>& model, const std::shared_ptr<ModelJob>& job)
+	{
+		if (job->read) {
+			model->fromCache = job->fromCache;
+			model->upload(job->path, job->meshes, &job->images, pixelBuffer());
+		}
+		// Arrived, even if empty, so nothing waits on it forever
+		model->loaded = true;
+	}
+
+	// Called on a worker, hands the GL side of a job to update()
+	void complete(Upload upload)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uploads.push_back(std::move(upload));
+	}
+
+	// Staging buffer for texture uploads, created on the GL thread the first time it is needed
+	unsigned int pixelBuffer()
+	{
+		if (pixelUnpackBuffer == 0)
+			glGenBuffers(1, &pixelUnpackBuffer);
+		return pixelUnpackBuffer;
+	}
+};
+#endif
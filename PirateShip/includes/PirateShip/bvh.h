@@ -0,0 +1,130 @@
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <PirateShip/aabb.h>
+#include <PirateShip/triangle_buffer.h>
+
+// Bounding volume hierarchy over a triangle soup, used as the collision broad-phase
+class BVH
+{
+public:
+	// Triangles per leaf before a node is split
+	static const unsigned int maxLeafSize = 4;
+	// Deepest possible tree is bounded by the median split, 64 levels covers any realistic mesh
+	static const unsigned int maxDepth = 64;
+
+	struct Node {
+		AABB bounds;
+		// Interior: index of the left child (right child is left + 1)
+		// Leaf: offset of the first triangle in indices
+		unsigned int leftFirst;
+		// Number of triangles, 0 for interior nodes
+		unsigned int count;
+	};
+
+	std::vector<Node> nodes;
+	// Triangle indices ordered so each leaf refers to a contiguous range
+	std::vector<unsigned int> indices;
+
+	// Build the tree over triangles given in ellipsoid space
+	void build(const TriangleBuffer& triangles)
+	{
+		nodes.clear();
+		indices.resize(triangles.size());
+		centroids.resize(triangles.size());
+		triangleBounds.resize(triangles.size());
+
+		for (unsigned int i = 0; i < triangles.size(); i++) {
+			indices[i] = i;
+			AABB box;
+			box.expand(triangles[i].p1);
+			box.expand(triangles[i].p2);
+			box.expand(triangles[i].p3);
+			triangleBounds[i] = box;
+			centroids[i] = box.center();
+		}
+
+		if (triangles.empty())
+			return;
+
+		nodes.reserve(2 * triangles.size());
+		nodes.push_back(Node{ AABB(), 0, (unsigned int)triangles.size() });
+		subdivide(0, 0);
+	}
+
+	// Append the indices of every triangle whose bounds overlap box
+	void query(const AABB& box, std::vector<unsigned int>& out) const
+	{
+		if (nodes.empty())
+			return;
+
+		unsigned int stack[maxDepth];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+			if (!node.bounds.overlaps(box))
+				continue;
+
+			if (node.count > 0) {
+				for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+					if (triangleBounds[indices[i]].overlaps(box))
+						out.push_back(indices[i]);
+				}
+			}
+			else {
+				stack[stackSize++] = node.leftFirst + 1;
+				stack[stackSize++] = node.leftFirst;
+			}
+		}
+	}
+
+private:
+	std::vector<glm::vec3> centroids;
+	std::vector<AABB> triangleBounds;
+
+	// Recursively split a node at the centroid median of its longest axis
+	void subdivide(unsigned int nodeIndex, unsigned int depth)
+	{
+		unsigned int first = nodes[nodeIndex].leftFirst;
+		unsigned int count = nodes[nodeIndex].count;
+
+		AABB bounds;
+		AABB centroidBounds;
+		for (unsigned int i = first; i < first + count; i++) {
+			bounds.expand(triangleBounds[indices[i]]);
+			centroidBounds.expand(centroids[indices[i]]);
+		}
+		nodes[nodeIndex].bounds = bounds;
+
+		if (count <= maxLeafSize || depth >= maxDepth - 2)
+			return;
+
+		// Split along the axis the centroids are most spread on
+		glm::vec3 extent = centroidBounds.extent();
+		int axis = 0;
+		if (extent.y > extent.x) axis = 1;
+		if (extent.z > extent[axis]) axis = 2;
+
+		unsigned int half = count / 2;
+		std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+			[this, axis](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+		unsigned int left = (unsigned int)nodes.size();
+		nodes.push_back(Node{ AABB(), first, half });
+		nodes.push_back(Node{ AABB(), first + half, count - half });
+		nodes[nodeIndex].leftFirst = left;
+		nodes[nodeIndex].count = 0;
+
+		subdivide(left, depth + 1);
+		subdivide(left + 1, depth + 1);
+	}
+};
+#endif
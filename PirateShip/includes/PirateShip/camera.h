@@ -5,7 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <PirateShip/entity.h>
+#include <PirateShip/physics.h>
 
 #include <vector>
 #include <memory>
@@ -45,7 +45,8 @@ public:
     float MouseSensitivity;
     float Zoom;
 
-    std::shared_ptr<CharacterEntity> entity;
+    // Movement input goes to the physics thread, which owns the player entity
+    std::shared_ptr<PhysicsThread> physics;
 
     // constructor with vectors
     Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
@@ -74,21 +75,16 @@ public:
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
-    {   
-        float prev_y_vel = entity->velocity.y;
-        
+    {
         float velocity = MovementSpeed * deltaTime;
         if (direction == FORWARD)
-            entity->velocity += Front * velocity;
+            physics->addVelocity(Front * velocity);
         if (direction == BACKWARD)
-            entity->velocity -= Front * velocity;
+            physics->addVelocity(-Front * velocity);
         if (direction == LEFT)
-            entity->velocity -= Right * velocity;
+            physics->addVelocity(-Right * velocity);
         if (direction == RIGHT)
-            entity->velocity += Right * velocity;
-
-        // Lock y-velocity to be level so the player can't fly upwards
-        //entity->velocity.y = prev_y_vel;
+            physics->addVelocity(Right * velocity);
     }
 
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
@@ -123,8 +119,8 @@ public:
             Zoom = 45.0f;
     }
 
-    void setEntity(std::shared_ptr<CharacterEntity>& e) {
-        entity = e;
+    void setPhysics(std::shared_ptr<PhysicsThread>& p) {
+        physics = p;
     }
 
 private:
@@ -22,9 +22,13 @@ public:
 	//unsigned int _WaveTex = loadTexture("resources/plane/Wave_Dist_1.jpg");
 	//unsigned int _ColorTex = loadTexture("resources/plane/UpperColor.jpg");
 
+	// Uses the shader. The settings never change and a program keeps its uniforms, so they are only set the first time.
 	void setCloudsShader(Shader& cloudsShader)
 	{
 		cloudsShader.use();
+		if (cloudsShader.ID == configured)
+			return;
+		configured = cloudsShader.ID;
 
 		// Textures
 		cloudsShader.setInt("_CloudTex1", 0);
@@ -77,6 +81,7 @@ public:
 		cloudsShader.setFloat("_Steps", 70.0f);
 	}
 
+	// The samplers were pointed at these units by setCloudsShader
 	void bindCloudsTextures(Shader& cloudsShader, 
 		const unsigned int _CloudTex1,
 		const unsigned int _FlowTex1,
@@ -84,30 +89,24 @@ public:
 		const unsigned int _WaveTex,
 		const unsigned int _ColorTex)
 	{
+		(void)cloudsShader;
 		glActiveTexture(GL_TEXTURE0);
-		cloudsShader.setInt("_CloudTex1", 0);
-		//glUniform1i(glGetUniformLocation(cloudsShader.ID, "_CloudTex1"), 0);
 		glBindTexture(GL_TEXTURE_2D, _CloudTex1);
 
 		glActiveTexture(GL_TEXTURE1);
-		cloudsShader.setInt("_FlowTex1", 1);
-		//glUniform1i(glGetUniformLocation(cloudsShader.ID, "_FlowTex1"), 1);
 		glBindTexture(GL_TEXTURE_2D, _FlowTex1);
 
 		glActiveTexture(GL_TEXTURE2);
-		cloudsShader.setInt("_CloudTex2", 2);
-		//glUniform1i(glGetUniformLocation(cloudsShader.ID, "_CloudTex2"), 2);
 		glBindTexture(GL_TEXTURE_2D, _CloudTex2);
 
 		glActiveTexture(GL_TEXTURE3);
-		cloudsShader.setInt("_WaveTex", 3);
-		//glUniform1i(glGetUniformLocation(cloudsShader.ID, "_WaveTex"), 3);
 		glBindTexture(GL_TEXTURE_2D, _WaveTex);
 
 		glActiveTexture(GL_TEXTURE4);
-		cloudsShader.setInt("_ColorTex", 4);
-		//glUniform1i(glGetUniformLocation(cloudsShader.ID, "_ColorTex"), 4);
 		glBindTexture(GL_TEXTURE_2D, _ColorTex);
 	}
+
+private:
+	GLuint configured = 0;
 };
 #endif
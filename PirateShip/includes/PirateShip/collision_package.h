@@ -1,7 +1,6 @@
 #ifndef COLLISION_PACKAGE_H
 #define COLLISION_PACKAGE_H
 
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef COLLISION_WORLD_H
+#define COLLISION_WORLD_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+#include <PirateShip/bvh.h>
+#include <PirateShip/spatial_hash.h>
+#include <PirateShip/triangle_buffer.h>
+#include <PirateShip/triangle_soa.h>
+
+// Spatial index an entity narrows its triangles down with
+enum BroadPhase {
+	BROAD_PHASE_LINEAR,
+	BROAD_PHASE_BVH,
+	BROAD_PHASE_GRID
+};
+
+// Static collision geometry cached in ellipsoid space.
+// Triangles are only recomputed when a hitbox transform or the ellipsoid radius changes.
+class CollisionWorld
+{
+public:
+	// Transformed triangles of every hitbox, each hitbox owns a fixed range
+	TriangleBuffer triangles;
+	// The same triangles laid out for the SIMD narrow-phase
+	TriangleSoA soa;
+	// Broad-phase over the triangles, rebuilt whenever they change
+	BVH bvh;
+	// Optional uniform grid broad-phase, only built once a cell size is set
+	SpatialHash grid;
+
+	// Add a hitbox mesh in model space, returns its handle for setTransform
+	unsigned int addHitbox(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& transform = glm::mat4(1.0f))
+	{
+		Hitbox hitbox;
+		hitbox.positions = positions;
+		hitbox.indices = indices;
+		hitbox.transform = transform;
+		hitbox.firstTriangle = (unsigned int)triangles.size();
+		hitbox.dirty = true;
+
+		triangles.resize(triangles.size() + indices.size() / 3);
+		soa.resize(triangles.size());
+		hitboxes.push_back(hitbox);
+		return (unsigned int)hitboxes.size() - 1;
+	}
+
+	void setTransform(unsigned int hitbox, const glm::mat4& transform)
+	{
+		if (hitboxes[hitbox].transform != transform) {
+			hitboxes[hitbox].transform = transform;
+			hitboxes[hitbox].dirty = true;
+		}
+	}
+
+	void setRadius(const glm::vec3& radius)
+	{
+		if (eRadius != radius) {
+			eRadius = radius;
+			for (Hitbox& hitbox : hitboxes)
+				hitbox.dirty = true;
+		}
+	}
+
+	// Build the grid with cells of this size in ellipsoid space, 0 disables it
+	void setGridCellSize(float size)
+	{
+		if (gridCellSize != size) {
+			gridCellSize = size;
+			gridDirty = true;
+		}
+	}
+
+	// Recompute the triangles of changed hitboxes, returns true if anything changed
+	bool update()
+	{
+		bool changed = false;
+		for (Hitbox& hitbox : hitboxes) {
+			if (!hitbox.dirty)
+				continue;
+			transformHitbox(hitbox);
+			hitbox.dirty = false;
+			changed = true;
+		}
+		if (changed)
+			bvh.build(triangles);
+		if (changed || gridDirty) {
+			grid = SpatialHash();
+			if (gridCellSize > 0.0f) {
+				grid.cellSize = gridCellSize;
+				grid.build(triangles);
+			}
+			gridDirty = false;
+		}
+		return changed;
+	}
+
+	glm::vec3 getRadius() const { return eRadius; }
+
+private:
+	struct Hitbox {
+		std::vector<glm::vec3> positions;
+		std::vector<unsigned int> indices;
+		glm::mat4 transform;
+		unsigned int firstTriangle;
+		bool dirty;
+	};
+
+	std::vector<Hitbox> hitboxes;
+	glm::vec3 eRadius = glm::vec3(1.0f);
+	float gridCellSize = 0.0f;
+	bool gridDirty = false;
+
+	// Convert into ellipsoid space, then apply the hitbox transform
+	void transformHitbox(const Hitbox& hitbox)
+	{
+		unsigned int t = hitbox.firstTriangle;
+		for (unsigned int i = 0; i + 2 < hitbox.indices.size(); i += 3, t++) {
+			glm::vec3 vertices[3];
+			for (unsigned int v = 0; v < 3; v++) {
+				glm::vec4 vertex = glm::vec4(hitbox.positions[hitbox.indices[i + v]] / eRadius, 1);
+				vertices[v] = glm::vec3(hitbox.transform * vertex);
+			}
+			triangles[t].set(vertices[0], vertices[1], vertices[2]);
+			soa.set(t, triangles[t]);
+		}
+	}
+};
+#endif
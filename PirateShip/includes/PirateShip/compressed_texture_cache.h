@@ -0,0 +1,161 @@
+#pragma once
+#ifndef COMPRESSED_TEXTURE_CACHE_H
+#define COMPRESSED_TEXTURE_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <PirateShip/mesh_cache.h>
+#include <PirateShip/texture.h>
+#include <PirateShip/texture_compressor.h>
+
+// Block compressed mip chain of a texture, stored next to the source image.
+// Loading one is a memory map and a copy per level, no decoding, mip filtering or compression.
+class CompressedTextureCache
+{
+public:
+	// Bump whenever the file layout or the encoder's output changes
+	static const uint32_t version = 1;
+
+	// Each role and orientation gets a file of its own, they encode differently
+	static std::string cachePath(const std::string& source, TextureRole role, bool flipVertically)
+	{
+		static const char* roles[] = { "color", "normal", "mask", "flow" };
+		return source + '.' + roles[role] + (flipVertically ? "" : ".upright") + ".texcache";
+	}
+
+	// Fill image from the cache of source, false if there is none or it is out of date
+	static bool load(const std::string& source, TextureRole role, bool flipVertically, EncodedImage& image)
+	{
+		SourceInfo info;
+		if (!SourceInfo::read(source, info))
+			return false;
+
+		std::string path = cachePath(source, role, flipVertically);
+		Header header;
+		{
+			MappedFile file;
+			if (!file.open(path) || file.size() < sizeof(Header))
+				return false;
+			memcpy(&header, file.data(), sizeof(header));
+			if (!current(header) || header.sourceSize != info.size)
+				return false;
+			if (header.sourceTime != info.time && header.sourceHash != SourceInfo::hash(source))
+				return false;
+
+			// Every level's size follows from the format and dimensions, so they are checked before anything is read
+			TextureFormat format = (TextureFormat)header.format;
+			size_t offset = sizeof(Header);
+			EncodedImage loaded;
+			loaded.format = format;
+			loaded.width = (int)header.width;
+			loaded.height = (int)header.height;
+			loaded.levels.resize(header.levelCount);
+			for (uint32_t i = 0; i < header.levelCount; i++) {
+				size_t size = TextureCompressor::levelSize(format, std::max(loaded.width >> i, 1), std::max(loaded.height >> i, 1));
+				if (size > file.size() - offset) {
+					std::cout << "ERROR::TEXTURE_CACHE::CORRUPT " << path << std::endl;
+					return false;
+				}
+				loaded.levels[i].assign(file.data() + offset, file.data() + offset + size);
+				offset += size;
+			}
+			image = std::move(loaded);
+		}
+
+		// Remember the new timestamp so the next launch can skip hashing
+		if (header.sourceTime != info.time) {
+			header.sourceTime = info.time;
+			std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+			file.write((const char*)&header, sizeof(header));
+		}
+		return true;
+	}
+
+	// Write the image encoded from source into its cache
+	static bool save(const std::string& source, TextureRole role, bool flipVertically, const EncodedImage& image)
+	{
+		SourceInfo info;
+		if (!SourceInfo::read(source, info))
+			return false;
+
+		Header header;
+		memcpy(header.magic, magic(), sizeof(header.magic));
+		header.version = version;
+		header.format = (uint32_t)image.format;
+		header.width = (uint32_t)image.width;
+		header.height = (uint32_t)image.height;
+		header.levelCount = (uint32_t)image.levels.size();
+		header.sourceSize = info.size;
+		header.sourceTime = info.time;
+		header.sourceHash = SourceInfo::hash(source);
+
+		std::string path = cachePath(source, role, flipVertically);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cout << "ERROR::TEXTURE_CACHE::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		for (size_t i = 0; i < image.levels.size(); i++)
+			file.write((const char*)image.levels[i].data(), image.levels[i].size());
+
+		if (!file) {
+			// Never leave a half written cache behind
+			file.close();
+			remove(path.c_str());
+			std::cout << "ERROR::TEXTURE_CACHE::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+	};
+
+	static const char* magic() { return "PSTC"; }
+
+	static bool current(const Header& header)
+	{
+		return memcmp(header.magic, magic(), sizeof(header.magic)) == 0 &&
+			header.version == version &&
+			header.format >= FORMAT_BC1 && header.format <= FORMAT_BC5 &&
+			header.width > 0 && header.height > 0 && header.width <= 16384 && header.height <= 16384 &&
+			header.levelCount > 0 && header.levelCount <= 15;
+	}
+};
+
+bool loadEncodedImage(const std::string& path, TextureRole role, bool flipVertically, bool compress, EncodedImage& image);
+
+// Read a texture ready for upload: from its compressed texture cache if that is current, otherwise decoded and encoded
+// now, and cached for next time. Without compress it is plain RGBA8 and never cached. False if the source can't be read.
+bool loadEncodedImage(const std::string& path, TextureRole role, bool flipVertically, bool compress, EncodedImage& image)
+{
+	if (compress && CompressedTextureCache::load(path, role, flipVertically, image))
+		return true;
+
+	DecodedImage decoded = decodeImage(path.c_str(), flipVertically);
+	if (!decoded.pixels)
+		return false;
+	image = TextureCompressor::encode(decoded, role, compress);
+	if (compress)
+		CompressedTextureCache::save(path, role, flipVertically, image);
+	return true;
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef CROWD_H
+#define CROWD_H
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include <PirateShip/collision_world.h>
+#include <PirateShip/entity.h>
+#include <PirateShip/thread_pool.h>
+
+// Many entities (crew, NPCs) colliding against one shared collision world.
+// Each entity keeps its own CollisionPackage, so entities can be stepped on different threads
+// as long as the world is not updated at the same time.
+class Crowd
+{
+public:
+	std::shared_ptr<CollisionWorld> world;
+	std::vector<std::shared_ptr<CharacterEntity>> entities;
+
+	// Entities handed to a task at a time, small enough to balance, large enough to amortise the task
+	size_t grainSize = 16;
+
+	explicit Crowd(const std::shared_ptr<CollisionWorld>& world) : world(world) {}
+
+	std::shared_ptr<CharacterEntity> spawn(const glm::vec3& position)
+	{
+		std::shared_ptr<CharacterEntity> entity = std::make_shared<CharacterEntity>();
+		entity->position = position;
+		// World triangles are in the ellipsoid space of this radius
+		entity->collisionPackage->eRadius = world->getRadius();
+		entity->setWorld(world);
+		entities.push_back(entity);
+		return entity;
+	}
+
+	// Collide and slide every entity, spread over the pool
+	void update(ThreadPool& pool, bool useGravity)
+	{
+		pool.parallelFor(entities.size(), grainSize, [this, useGravity](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				entities[i]->update(useGravity);
+		});
+	}
+};
+#endif
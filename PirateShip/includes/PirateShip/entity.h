@@ -2,16 +2,32 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 
+#include <PirateShip/aabb.h>
+#include <PirateShip/collision_world.h>
 #include <PirateShip/plane.h>
 #include <PirateShip/collision_package.h>
 #include <PirateShip/math.h>
+#include <PirateShip/simd_math.h>
+
+// Counters for profiling the collision path, owners reset them whenever they like
+struct CollisionStats {
+	// collideWithWorld gives up after this many slides
+	static const int maxRecursionDepth = 6;
+
+	unsigned long long queries = 0;
+	unsigned long long trianglesTested = 0;
+	// Number of collideWithWorld calls that settled after each number of slides
+	unsigned long long depthHistogram[maxRecursionDepth + 1] = {};
+
+	void reset() { *this = CollisionStats(); }
+};
 
 class CharacterEntity 
 {
@@ -22,7 +38,14 @@ public:
 	bool grounded = false;
 	int collisionRecursionDepth;
 	std::unique_ptr<CollisionPackage> collisionPackage;
-	std::vector<std::vector<glm::vec3>> triangles;
+	// Static geometry this entity collides against
+	std::shared_ptr<CollisionWorld> world;
+	// Broad-phase to query, BROAD_PHASE_LINEAR tests every triangle
+	// (the grid falls back to the BVH if the world has not built one)
+	BroadPhase broadPhase = BROAD_PHASE_BVH;
+	// Narrow-phase instruction set, SIMD_SCALAR tests one triangle at a time with Math::checkTriangle
+	SimdIsa simdIsa = SimdMath::bestIsa();
+	CollisionStats stats;
 
 	CharacterEntity() {
 		collisionPackage = std::make_unique<CollisionPackage>();
@@ -45,6 +68,7 @@ public:
 		// Iterate until we have our final position.
 		collisionRecursionDepth = 0;
 		glm::vec3 finalPosition = collideWithWorld(eSpacePosition, eSpaceVelocity);
+		stats.depthHistogram[collisionRecursionDepth]++;
 		
 		// Add gravity pull:
 		// Set the new R3 position (convert back from eSpace to R3)
@@ -53,6 +77,7 @@ public:
 		eSpaceVelocity = gravity / collisionPackage->eRadius;
 		collisionRecursionDepth = 0;
 		finalPosition = collideWithWorld(finalPosition, eSpaceVelocity);
+		stats.depthHistogram[collisionRecursionDepth]++;
 		
 		// Convert final result back to R3:
 		finalPosition = finalPosition * collisionPackage->eRadius;
@@ -68,7 +93,7 @@ public:
 		float veryCloseDistance = 0.005f * unitScale;
 		
 		// do we need to worry?
-		if (collisionRecursionDepth > 5)
+		if (collisionRecursionDepth >= CollisionStats::maxRecursionDepth)
 			return pos;
 		
 		// Ok, we need to worry:
@@ -127,10 +152,45 @@ public:
 		return collideWithWorld(newBasePoint, newVelocityVector);
 	}
 
+	// The world is shared and only read here, so many entities can collide against it at once
+	void setWorld(const std::shared_ptr<CollisionWorld>& newWorld)
+	{
+		world = newWorld;
+	}
+
 	void checkCollision()
 	{
-		for (std::vector<glm::vec3> triangle : triangles) {
-			Math::checkTriangle(collisionPackage, triangle[0], triangle[1], triangle[2]);
+		if (!world)
+			return;
+		stats.queries++;
+
+		if (broadPhase == BROAD_PHASE_LINEAR) {
+			checkCollisionBruteForce();
+			return;
+		}
+
+		// Only triangles touching the box around the swept unit sphere can be hit
+		AABB sweptBox = AABB::sweptSphere(collisionPackage->basePoint, collisionPackage->velocity, 1.0f + collisionEpsilon);
+		// Room for every triangle, so queries never have to grow it
+		if (candidates.capacity() < world->triangles.size())
+			candidates.reserve(world->triangles.size());
+		candidates.clear();
+		if (broadPhase == BROAD_PHASE_GRID && !world->grid.empty())
+			world->grid.query(sweptBox, candidates);
+		else
+			world->bvh.query(sweptBox, candidates);
+
+		// Test in the original order so ties resolve exactly like the linear scan
+		std::sort(candidates.begin(), candidates.end());
+		stats.trianglesTested += candidates.size();
+		SimdMath::checkTriangles(collisionPackage, *world, candidates.data(), (unsigned int)candidates.size(), simdIsa);
+	}
+
+	void checkCollisionBruteForce()
+	{
+		stats.trianglesTested += world->triangles.size();
+		for (const CollisionTriangle& triangle : world->triangles) {
+			Math::checkTriangle(collisionPackage, triangle);
 		}
 	}
 
@@ -150,5 +210,11 @@ public:
 
 		collideAndSlide(gravity, velocity);
 	}
+
+private:
+	// Slack added to the swept box so rounding can't drop a touching triangle
+	const float collisionEpsilon = 1e-3f;
+	// Scratch list of broad-phase hits, kept to avoid reallocating every query
+	std::vector<unsigned int> candidates;
 };
 #endif
@@ -0,0 +1,209 @@
+#pragma once
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+#include <PirateShip/shader_m.h>
+
+// Binding points of the uniform blocks, the same in every program
+enum UniformBlockBinding {
+	CAMERA_BLOCK = 0,
+	LIGHTS_BLOCK = 1
+};
+
+// The shaders' std140 blocks, member for member. A vec3 is padded to 16 bytes unless a float follows it.
+//
+// layout (std140) uniform Camera {
+//     mat4 projection;
+//     mat4 view;
+//     vec3 viewPos;
+//     float _Time;
+// };
+struct CameraBlock {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	float time;
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match the std140 Camera block");
+
+struct DirLightBlock {
+	glm::vec3 direction;
+	float padding0;
+	glm::vec3 ambient;
+	float padding1;
+	glm::vec3 diffuse;
+	float padding2;
+	glm::vec3 specular;
+	float padding3;
+};
+
+// The attenuation terms fill the space after each colour
+struct PointLightBlock {
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float padding;
+};
+
+// layout (std140) uniform Lights {
+//     DirLight dirLight;
+//     PointLight pointLights[NR_POINT_LIGHTS];
+// };
+const int pointLightCount = 4;
+struct LightsBlock {
+	DirLightBlock dirLight;
+	PointLightBlock pointLights[pointLightCount];
+};
+static_assert(sizeof(LightsBlock) == 64 + 64 * pointLightCount, "LightsBlock must match the std140 Lights block");
+
+// The camera and lights every program reads, written once a frame into a ring of uniform buffer segments.
+// The GPU can still be reading the last frames' segments, so each segment is fenced when the frame moves on and
+// only written again once the fence has passed. On GL 4.4 the buffer stays mapped, older contexts map the
+// segment unsynchronised each frame, which the fences make safe.
+class FrameUniforms
+{
+public:
+	// Segments in the ring, the GPU can run this many frames behind before update() waits
+	static const int frameCount = 3;
+
+	// Filled in by the frame, then sent with update()
+	CameraBlock camera = {};
+	LightsBlock lights = {};
+
+	// Frames update() had to wait for the GPU to finish with a segment
+	unsigned int stalls = 0;
+
+	// True once glad has loaded a 4.4 context. Built against a glad without 4.4 this is always false.
+	static bool persistent()
+	{
+#ifdef GL_VERSION_4_4
+		return GLAD_GL_VERSION_4_4 != 0;
+#else
+		return false;
+#endif
+	}
+
+	// Point a program's Camera and Lights blocks, those it has, at the ring's binding points
+	static void attach(const Shader& shader)
+	{
+		GLuint camera = glGetUniformBlockIndex(shader.ID, "Camera");
+		if (camera != GL_INVALID_INDEX)
+			glUniformBlockBinding(shader.ID, camera, CAMERA_BLOCK);
+		GLuint lights = glGetUniformBlockIndex(shader.ID, "Lights");
+		if (lights != GL_INVALID_INDEX)
+			glUniformBlockBinding(shader.ID, lights, LIGHTS_BLOCK);
+	}
+
+	FrameUniforms() {}
+	~FrameUniforms()
+	{
+		for (int i = 0; i < frameCount; i++) {
+			if (fences[i])
+				glDeleteSync(fences[i]);
+		}
+		if (buffer != 0) {
+			if (mapped) {
+				glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+				glUnmapBuffer(GL_UNIFORM_BUFFER);
+				glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	// Copy camera and lights into the next segment and bind it for the frame's draws
+	void update()
+	{
+		if (buffer == 0)
+			create();
+
+		// Everything drawn so far read the current segment
+		if (current >= 0)
+			fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		current = (current + 1) % frameCount;
+		wait(current);
+
+		GLintptr offset = (GLintptr)(current * segmentSize);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		unsigned char* segment = mapped ? mapped + offset :
+			(unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, offset, (GLsizeiptr)segmentSize,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (segment) {
+			memcpy(segment, &camera, sizeof(CameraBlock));
+			memcpy(segment + lightsOffset, &lights, sizeof(LightsBlock));
+			if (!mapped)
+				glUnmapBuffer(GL_UNIFORM_BUFFER);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK, buffer, offset, sizeof(CameraBlock));
+		glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BLOCK, buffer, offset + (GLintptr)lightsOffset, sizeof(LightsBlock));
+	}
+
+private:
+	// One segment per frame in flight, each block at an offset GL accepts for a binding
+	void create()
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment < 1)
+			alignment = 256;
+		lightsOffset = alignUp(sizeof(CameraBlock), (size_t)alignment);
+		segmentSize = alignUp(lightsOffset + sizeof(LightsBlock), (size_t)alignment);
+		GLsizeiptr size = (GLsizeiptr)(segmentSize * frameCount);
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+#ifdef GL_VERSION_4_4
+		if (persistent()) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+		}
+		else
+#endif
+			glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// Block until the GPU has finished the frame that last read a segment
+	void wait(int slot)
+	{
+		if (!fences[slot])
+			return;
+		GLenum result = glClientWaitSync(fences[slot], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			stalls++;
+			while (result == GL_TIMEOUT_EXPIRED)
+				result = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+	}
+
+	static size_t alignUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	GLuint buffer = 0;
+	unsigned char* mapped = nullptr;	// the whole ring, persistently mapped, or null if segments are mapped per frame
+	size_t segmentSize = 0;
+	size_t lightsOffset = 0;
+	GLsync fences[frameCount] = {};
+	int current = -1;
+};
+#endif
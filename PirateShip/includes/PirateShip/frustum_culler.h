@@ -0,0 +1,151 @@
+#pragma once
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include <PirateShip/mesh.h>
+#include <PirateShip/model.h>
+#include <PirateShip/simd_math.h>
+
+// The six planes of a view frustum, normals pointing inwards, taken from the rows of projection * view.
+// The planes aren't normalised, only the side a point is on counts.
+struct Frustum {
+	glm::vec4 planes[6];
+
+	static Frustum fromMatrices(const glm::mat4& projection, const glm::mat4& view)
+	{
+		glm::mat4 m = projection * view;
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++)
+			rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+
+		Frustum frustum;
+		for (int axis = 0; axis < 3; axis++) {
+			frustum.planes[axis * 2] = rows[3] + rows[axis];
+			frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+		}
+		return frustum;
+	}
+
+	// False only if the box, given by its center and half extent, lies entirely behind one plane
+	bool intersects(const glm::vec3& center, const glm::vec3& extent) const
+	{
+		for (const glm::vec4& plane : planes) {
+			glm::vec3 normal = glm::vec3(plane);
+			if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f)
+				return false;
+		}
+		return true;
+	}
+};
+
+// Culls the meshes of a frame's models against the view frustum, all of them at once and a SIMD batch of boxes at a time.
+// Meshes outside the view get Mesh::visible cleared, so Model's draws skip them until the next cull.
+class FrustumCuller
+{
+public:
+	// Meshes of the last cull found outside the view, and left to draw
+	unsigned int culled = 0;
+	unsigned int submitted = 0;
+
+	// Start a frame's cull, with the matrices the frame draws with
+	void begin(const glm::mat4& projection, const glm::mat4& view)
+	{
+		frustum = Frustum::fromMatrices(projection, view);
+		meshes.clear();
+		for (std::vector<float>& axis : centers)
+			axis.clear();
+		for (std::vector<float>& axis : extents)
+			axis.clear();
+	}
+
+	// Add the meshes of a model drawn with transform. Meshes without geometry are never culled.
+	void add(Model& model, const glm::mat4& transform)
+	{
+		for (Mesh& mesh : model.meshes) {
+			if (mesh.bounds.empty()) {
+				mesh.visible = true;
+				continue;
+			}
+			AABB box = mesh.bounds.transformed(transform);
+			glm::vec3 center = box.center();
+			glm::vec3 extent = box.extent() * 0.5f;
+			meshes.push_back(&mesh);
+			for (int axis = 0; axis < 3; axis++) {
+				centers[axis].push_back(center[axis]);
+				extents[axis].push_back(extent[axis]);
+			}
+		}
+	}
+
+	// Test every box added since begin() and mark the meshes
+	void cull(SimdIsa isa = SimdMath::bestIsa())
+	{
+		size_t count = meshes.size();
+		// Pad to whole batches, the extra lanes are never read back
+		size_t padded = (count + 7) / 8 * 8;
+		for (int axis = 0; axis < 3; axis++) {
+			centers[axis].resize(padded, 0.0f);
+			extents[axis].resize(padded, 0.0f);
+		}
+
+		switch (isa) {
+#ifdef PIRATESHIP_AVX2
+		case SIMD_AVX2:
+			cullBatches<Float8>(count);
+			break;
+#endif
+		case SIMD_SSE:
+			cullBatches<Float4>(count);
+			break;
+		default:
+			for (size_t i = 0; i < count; i++) {
+				meshes[i]->visible = frustum.intersects(glm::vec3(centers[0][i], centers[1][i], centers[2][i]),
+					glm::vec3(extents[0][i], extents[1][i], extents[2][i]));
+			}
+			break;
+		}
+
+		submitted = 0;
+		for (size_t i = 0; i < count; i++)
+			submitted += meshes[i]->visible ? 1 : 0;
+		culled = (unsigned int)count - submitted;
+	}
+
+private:
+	template<class F>
+	void cullBatches(size_t count)
+	{
+		F zero(0.0f);
+		for (size_t first = 0; first < count; first += F::width) {
+			F center[3], extent[3];
+			for (int axis = 0; axis < 3; axis++) {
+				center[axis] = F::load(centers[axis].data() + first);
+				extent[axis] = F::load(extents[axis].data() + first);
+			}
+
+			// A box is outside if it is entirely behind any plane
+			F outside = zero;
+			for (const glm::vec4& plane : frustum.planes) {
+				F distance = center[0] * F(plane.x) + center[1] * F(plane.y) + center[2] * F(plane.z) + F(plane.w) +
+					extent[0] * F(std::fabs(plane.x)) + extent[1] * F(std::fabs(plane.y)) + extent[2] * F(std::fabs(plane.z));
+				outside = outside | (distance < zero);
+			}
+
+			int hidden = outside.mask();
+			for (size_t i = 0; i < F::width && first + i < count; i++)
+				meshes[first + i]->visible = (hidden & (1 << i)) == 0;
+		}
+	}
+
+	Frustum frustum;
+	std::vector<Mesh*> meshes;
+	// World space boxes of the meshes, center and half extent per axis
+	std::vector<float> centers[3];
+	std::vector<float> extents[3];
+};
+#endif
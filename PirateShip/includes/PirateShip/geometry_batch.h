@@ -0,0 +1,264 @@
+#pragma once
+#ifndef GEOMETRY_BATCH_H
+#define GEOMETRY_BATCH_H
+
+#include <glad/glad.h>
+
+#include <PirateShip/instance_buffer.h>
+#include <PirateShip/mesh.h>
+#include <PirateShip/shader_m.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One glMultiDrawElementsIndirect command, laid out the way GL reads it from the indirect buffer
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// A mesh's level of detail as a range of its own indices, kept to draw it later whatever the mesh selects meanwhile
+struct MeshLevel {
+	GLuint firstIndex;
+	GLuint count;
+};
+
+// All meshes of a model suballocated into one vertex and one index buffer, drawn with a
+// glMultiDrawElementsIndirect per run of meshes that share a material instead of a draw per mesh.
+// Needs GL 4.3, Model falls back to drawing its meshes one by one on older contexts.
+class GeometryBatch
+{
+public:
+	// True once glad has loaded a 4.3 context. Built against a glad without 4.3 this is always false.
+	static bool supported()
+	{
+#ifdef GL_VERSION_4_3
+		return GLAD_GL_VERSION_4_3 != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool empty() const { return commands.empty(); }
+
+	// Upload the meshes, in order, into shared buffers. Only their CPU side data is read.
+	void build(const std::vector<Mesh>& meshes)
+	{
+#ifdef GL_VERSION_4_3
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		commands.clear();
+		groups.clear();
+		meshFirstIndex.clear();
+		for (const Mesh& mesh : meshes) {
+			// Indices stay local to their mesh, baseVertex moves them to its place in the shared buffer
+			DrawElementsIndirectCommand command = { (GLuint)mesh.indices.size(), 1, (GLuint)indices.size(), (GLint)vertices.size(), 0 };
+			meshFirstIndex.push_back(command.firstIndex);
+			vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+			// Levels of detail follow the mesh's own indices, as in Mesh's element buffer
+			indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+			indices.insert(indices.end(), mesh.lodIndices.begin(), mesh.lodIndices.end());
+
+			if (groups.empty() || groups.back().material != mesh.material)
+				groups.push_back(Group{ (unsigned int)commands.size(), 0, mesh.material });
+			groups.back().count++;
+			commands.push_back(command);
+		}
+		if (commands.empty())
+			return;
+
+		// One layout has to fit every mesh, so it is chosen over all of them, with the largest of their textures
+		int textureSize = 0;
+		bool texturesKnown = true;
+		for (const Mesh& mesh : meshes) {
+			texturesKnown = texturesKnown && mesh.textureSize() != 0;
+			textureSize = std::max(textureSize, mesh.textureSize());
+		}
+		format = VertexFormat::choose(vertices, texturesKnown ? textureSize : 0);
+		std::vector<unsigned char> packed = format.pack(vertices);
+		vertexBufferSize = packed.size();
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glGenBuffers(1, &indirectBuffer);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		format.setAttributes();
+		glBindVertexArray(0);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#else
+		(void)meshes;
+#endif
+	}
+
+	// Point each mesh's command at the level of detail the mesh selected. With skipHidden, meshes the
+	// frustum culler hid draw no indices.
+	void selectLevels(const std::vector<Mesh>& meshes, bool skipHidden)
+	{
+#ifdef GL_VERSION_4_3
+		bool changed = false;
+		for (size_t i = 0; i < commands.size() && i < meshes.size(); i++) {
+			GLuint firstIndex = meshFirstIndex[i] + meshes[i].levelFirstIndex(meshes[i].lod);
+			GLuint count = skipHidden && !meshes[i].visible ? 0 : meshes[i].levelIndexCount(meshes[i].lod);
+			if (commands[i].firstIndex != firstIndex || commands[i].count != count) {
+				commands[i].firstIndex = firstIndex;
+				commands[i].count = count;
+				changed = true;
+			}
+		}
+		if (!changed)
+			return;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#else
+		(void)meshes;
+		(void)skipHidden;
+#endif
+	}
+
+	// Draw every mesh, binding each group's material first if bindTextures is set
+	void draw(Shader& shader, bool bindTextures)
+	{
+#ifdef GL_VERSION_4_3
+		setInstanceCount(1);
+		glBindVertexArray(VAO);
+		// The indirect buffer binding is not part of the VAO
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		if (bindTextures) {
+			for (const Group& group : groups) {
+				group.material->bind(shader);
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(group.first * sizeof(DrawElementsIndirectCommand)), group.count, 0);
+			}
+		}
+		else
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+#else
+		(void)shader;
+		(void)bindTextures;
+#endif
+	}
+
+	// Draw every instance of every mesh, one multi-draw per group as for a single instance
+	void drawInstanced(Shader& shader, const InstanceBuffer& instances)
+	{
+#ifdef GL_VERSION_4_3
+		setInstanceCount((GLuint)instances.size());
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		instances.bind();
+		for (const Group& group : groups) {
+			group.material->bind(shader);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(group.first * sizeof(DrawElementsIndirectCommand)), group.count, 0);
+		}
+		instances.unbind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+#else
+		(void)shader;
+		(void)instances;
+#endif
+	}
+
+	// Number of multi-draw calls a textured draw issues, against one draw per mesh
+	size_t drawCalls() const { return groups.size(); }
+
+	// For a RenderQueue, which binds the vertex array and the group's material itself and draws the groups one by one
+	unsigned int vertexArray() const { return VAO; }
+	const Material& groupMaterial(size_t group) const { return *groups[group].material; }
+
+	// Draw one group's meshes, count instances of each, with the batch's vertex array bound
+	void drawGroup(size_t group, GLuint instances)
+	{
+#ifdef GL_VERSION_4_3
+		setInstanceCount(instances);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(groups[group].first * sizeof(DrawElementsIndirectCommand)), groups[group].count, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#else
+		(void)group;
+		(void)instances;
+#endif
+	}
+	// The meshes a group draws, counted from its first
+	size_t groupFirstMesh(size_t group) const { return groups[group].first; }
+	size_t groupMeshCount(size_t group) const { return (size_t)groups[group].count; }
+
+	// Point one group's commands at recorded levels, one per mesh of the group, as selectLevels does for all meshes
+	void setGroupLevels(size_t group, const MeshLevel* levels)
+	{
+#ifdef GL_VERSION_4_3
+		const Group& range = groups[group];
+		bool changed = false;
+		for (GLsizei i = 0; i < range.count; i++) {
+			DrawElementsIndirectCommand& command = commands[range.first + i];
+			GLuint firstIndex = meshFirstIndex[range.first + i] + levels[i].firstIndex;
+			if (command.firstIndex != firstIndex || command.count != levels[i].count) {
+				command.firstIndex = firstIndex;
+				command.count = levels[i].count;
+				changed = true;
+			}
+		}
+		if (!changed)
+			return;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, range.first * sizeof(DrawElementsIndirectCommand),
+			range.count * sizeof(DrawElementsIndirectCommand), &commands[range.first]);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#else
+		(void)group;
+		(void)levels;
+#endif
+	}
+	size_t meshCount() const { return commands.size(); }
+	size_t bufferSize() const { return vertexBufferSize; }
+
+private:
+	// Consecutive meshes with the same material, drawn by one multi-draw
+	struct Group {
+		unsigned int first;
+		GLsizei count;
+		std::shared_ptr<Material> material;
+	};
+
+	// Every command draws count instances, rewritten only when that changes
+	void setInstanceCount(GLuint count)
+	{
+#ifdef GL_VERSION_4_3
+		if (commands.empty() || commands[0].instanceCount == count)
+			return;
+		for (DrawElementsIndirectCommand& command : commands)
+			command.instanceCount = count;
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#else
+		(void)count;
+#endif
+	}
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<GLuint> meshFirstIndex;	// where each mesh's indices start in the shared element buffer
+	std::vector<Group> groups;
+	VertexFormat format;
+	size_t vertexBufferSize = 0;
+	unsigned int VAO = 0, VBO = 0, EBO = 0, indirectBuffer = 0;
+};
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// What an instanced draw reads per instance instead of the model and material uniforms
+struct InstanceData {
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec4 material = glm::vec4(1.0f);	// diffuse tint in rgb, specular scale in a
+};
+
+// Per instance transforms and material parameters on the GPU, for Model::DrawInstanced. Edit instances, then upload().
+class InstanceBuffer
+{
+public:
+	// Vertex attributes the instance data is read from, after the mesh's own. The model matrix takes four.
+	static const GLuint modelAttribute = 7;
+	static const GLuint materialAttribute = 11;
+
+	// Kept on the CPU as well, draws choose their level of detail from the transforms
+	std::vector<InstanceData> instances;
+
+	InstanceBuffer() {}
+	~InstanceBuffer()
+	{
+		if (buffer != 0)
+			glDeleteBuffers(1, &buffer);
+	}
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	size_t size() const { return uploaded; }
+
+	// Copy instances to the GPU. The old storage is orphaned, so draws still reading it don't stall the upload.
+	void upload()
+	{
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.empty() ? NULL : instances.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		uploaded = instances.size();
+	}
+
+	// Index of the instance closest to position, the one that needs the most detail. Only valid if size() > 0.
+	size_t nearest(const glm::vec3& position) const
+	{
+		size_t closest = 0;
+		float closestDistance = -1.0f;
+		for (size_t i = 0; i < uploaded && i < instances.size(); i++) {
+			glm::vec3 offset = glm::vec3(instances[i].model[3]) - position;
+			float distance = glm::dot(offset, offset);
+			if (closestDistance < 0.0f || distance < closestDistance) {
+				closest = i;
+				closestDistance = distance;
+			}
+		}
+		return closest;
+	}
+
+	// Point the instance attributes of the bound vertex array at the buffer, advancing once per instance
+	void bind() const
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (GLuint column = 0; column < 4; column++) {
+			glEnableVertexAttribArray(modelAttribute + column);
+			glVertexAttribPointer(modelAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(modelAttribute + column, 1);
+		}
+		glEnableVertexAttribArray(materialAttribute);
+		glVertexAttribPointer(materialAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, material));
+		glVertexAttribDivisor(materialAttribute, 1);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Leave the vertex array as the mesh set it up, for the draws that don't read instances
+	void unbind() const
+	{
+		for (GLuint column = 0; column < 4; column++)
+			glDisableVertexAttribArray(modelAttribute + column);
+		glDisableVertexAttribArray(materialAttribute);
+	}
+
+private:
+	unsigned int buffer = 0;
+	size_t uploaded = 0;
+};
+#endif
@@ -11,6 +11,7 @@
 #include <vector>
 #include <array>
 
+#include <PirateShip/frame_uniforms.h>
 #include <PirateShip/shader_m.h>
 #include <PirateShip/texture.h>
 
@@ -24,48 +25,41 @@ public:
 			glm::vec3(21.0417f, 13.0547f, 9.31641f)
 	};
 	
+	// Only the material is a uniform of the program, set once per shader. The lights are in the Lights block.
 	void setLightingShader(Shader& lightingShader)
 	{
+		if (lightingShader.ID == configured)
+			return;
+		configured = lightingShader.ID;
 		lightingShader.setFloat("material.shininess", 32.0f);
+	}
+
+	// The light set, as the shaders' Lights block reads it
+	LightsBlock lights() const
+	{
+		LightsBlock block = {};
 
 		// directional light
-		lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.25f);
-		lightingShader.setVec3("dirLight.diffuse", 0.5f, 0.6f, 0.5f);
-		lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+		block.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+		block.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.25f);
+		block.dirLight.diffuse = glm::vec3(0.5f, 0.6f, 0.5f);
+		block.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
 
-		// point light 1
-		lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-		lightingShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[0].constant", 1.0f);
-		lightingShader.setFloat("pointLights[0].linear", 0.09);
-		lightingShader.setFloat("pointLights[0].quadratic", 0.032);
-		// point light 2
-		lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-		lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[1].constant", 1.0f);
-		lightingShader.setFloat("pointLights[1].linear", 0.09);
-		lightingShader.setFloat("pointLights[1].quadratic", 0.032);
-		// point light 3
-		lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-		lightingShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[2].constant", 1.0f);
-		lightingShader.setFloat("pointLights[2].linear", 0.09);
-		lightingShader.setFloat("pointLights[2].quadratic", 0.032);
-		// point light 4
-		lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-		lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-		lightingShader.setFloat("pointLights[3].constant", 1.0f);
-		lightingShader.setFloat("pointLights[3].linear", 0.09);
-		lightingShader.setFloat("pointLights[3].quadratic", 0.032);
+		// point lights, all alike but for their positions
+		for (size_t i = 0; i < pointLightPositions.size() && i < (size_t)pointLightCount; i++) {
+			PointLightBlock& light = block.pointLights[i];
+			light.position = pointLightPositions[i];
+			light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+			light.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+			light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+			light.constant = 1.0f;
+			light.linear = 0.09f;
+			light.quadratic = 0.032f;
+		}
+		return block;
 	}
+
+private:
+	GLuint configured = 0;
 };
 #endif
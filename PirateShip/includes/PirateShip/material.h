@@ -0,0 +1,106 @@
+#pragma once
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <PirateShip/shader_m.h>
+
+struct CachedTexture;
+
+struct Texture {
+	unsigned int id;
+	std::string type;
+	std::string path;
+	std::shared_ptr<CachedTexture> handle;	// keeps id alive in the texture cache, null for textures not yet loaded
+	int size = 0;	// texels along the longer side, 0 if not known
+};
+
+// The textures a mesh is drawn with, bound to consecutive units. Each one's sampler is named after its type and its
+// number among the textures of that type, texture_diffuse1, texture_specular1 and so on. The names are built once,
+// and their locations looked up once per shader.
+class Material
+{
+public:
+	std::vector<Texture> textures;
+	unsigned int id;	// unique, materials are sorted by it
+
+	explicit Material(std::vector<Texture> textures) : textures(std::move(textures)), id(nextId())
+	{
+		unsigned int diffuseNr = 1;
+		unsigned int specularNr = 1;
+		unsigned int normalNr = 1;
+		unsigned int heightNr = 1;
+		for (const Texture& texture : this->textures) {
+			std::string number;
+			if (texture.type == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (texture.type == "texture_specular")
+				number = std::to_string(specularNr++);
+			else if (texture.type == "texture_normal")
+				number = std::to_string(normalNr++);
+			else if (texture.type == "texture_height")
+				number = std::to_string(heightNr++);
+			samplers.push_back(texture.type + number);
+		}
+	}
+
+	Material(const Material&) = delete;
+	Material& operator=(const Material&) = delete;
+
+	// Bind the textures and point the shader's samplers at them
+	void bind(const Shader& shader) const
+	{
+		const std::vector<GLint>& locations = samplerLocations(shader);
+		for (size_t i = 0; i < textures.size(); i++) {
+			glActiveTexture(GL_TEXTURE0 + (GLenum)i);
+			if (locations[i] != -1)
+				glUniform1i(locations[i], (GLint)i);
+			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		}
+	}
+
+	bool sameTextures(const std::vector<Texture>& other) const
+	{
+		if (textures.size() != other.size())
+			return false;
+		for (size_t i = 0; i < textures.size(); i++) {
+			if (textures[i].id != other[i].id || textures[i].type != other[i].type)
+				return false;
+		}
+		return true;
+	}
+
+private:
+	const std::vector<GLint>& samplerLocations(const Shader& shader) const
+	{
+		for (const ProgramLocations& resolved : locations) {
+			if (resolved.program == shader.ID)
+				return resolved.samplers;
+		}
+		locations.push_back(ProgramLocations{ shader.ID, std::vector<GLint>() });
+		for (const std::string& sampler : samplers)
+			locations.back().samplers.push_back(shader.location(sampler));
+		return locations.back().samplers;
+	}
+
+	static unsigned int nextId()
+	{
+		static unsigned int count = 0;
+		return ++count;
+	}
+
+	struct ProgramLocations {
+		GLuint program;
+		std::vector<GLint> samplers;
+	};
+
+	std::vector<std::string> samplers;
+	mutable std::vector<ProgramLocations> locations;	// a shader or two per material, a search is quicker than a map
+};
+#endif
@@ -2,13 +2,12 @@
 #ifndef MATH_H
 #define MATH_H
 
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/norm.hpp>
 
-#include <PirateShip/plane.h>
 #include <PirateShip/collision_package.h>
+#include <PirateShip/triangle_buffer.h>
 
 #include <vector>
 #include <memory>
@@ -19,20 +18,31 @@ public:
 	// Assumes: p1,p2 and p3 are given in ellipsoid space:
 	static void checkTriangle(std::unique_ptr<CollisionPackage>& colPackage, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3)
 	{
-		// Make the plane containing this triangle.
-		Plane trianglePlane(p1, p2, p3);
+		// Make the plane (and edges) of this triangle.
+		CollisionTriangle triangle;
+		triangle.set(p1, p2, p3);
+		checkTriangle(colPackage, triangle);
+	}
+
+	// Same test reading the plane and edges precomputed in triangle
+	static void checkTriangle(std::unique_ptr<CollisionPackage>& colPackage, const CollisionTriangle& triangle)
+	{
+		const glm::vec3& p1 = triangle.p1;
+		const glm::vec3& p2 = triangle.p2;
+		const glm::vec3& p3 = triangle.p3;
 		// Is triangle front-facing to the velocity vector?
 		// We only check front-facing triangles
 		// (your choice of course)
-		if (trianglePlane.isFrontFacingTo(colPackage->normalizedVelocity)) {
+		double facing = glm::dot(triangle.normal, colPackage->normalizedVelocity);
+		if (facing <= 0) {
 			// Get interval of plane intersection:
 			double t0, t1;
 			bool embeddedInPlane = false;
 			// Calculate the signed distance from sphere
 			// position to triangle plane
-			double signedDistToTrianglePlane = trianglePlane.signedDistanceTo(colPackage->basePoint);
+			double signedDistToTrianglePlane = glm::dot(colPackage->basePoint, triangle.normal) + triangle.planeConstant;
 			// cache this as we're going to use it a few times below:
-			float normalDotVelocity = glm::dot(trianglePlane.normal, colPackage->velocity);
+			float normalDotVelocity = glm::dot(triangle.normal, colPackage->velocity);
 			
 			// if sphere is travelling parrallel to the plane:
 			if (normalDotVelocity == 0.0f) {
@@ -84,7 +94,7 @@ public:
 			// of the triangle plane. Note, this can only happen if
 			// the sphere is not embedded in the triangle plane.
 			if (!embeddedInPlane) {
-				glm::vec3 planeIntersectionPoint = (colPackage->basePoint - trianglePlane.normal) + (float)t0 * colPackage->velocity;
+				glm::vec3 planeIntersectionPoint = (colPackage->basePoint - triangle.normal) + (float)t0 * colPackage->velocity;
 				if (checkPointInTriangle(planeIntersectionPoint,
 					p1, p2, p3))
 				{
@@ -123,31 +133,37 @@ public:
 
 				// Check against edges:
 				// p1 -> p2
-				check_edges(p1, p2, base, velocity, velocitySquaredLength, t, newT, foundCollision, collisionPoint);
+				check_edges(p1, triangle.edges[0], triangle.edgeSquaredLengths[0], base, velocity, velocitySquaredLength, t, newT, foundCollision, collisionPoint);
 				// p2 -> p3
-				check_edges(p2, p3, base, velocity, velocitySquaredLength, t, newT, foundCollision, collisionPoint);
+				check_edges(p2, triangle.edges[1], triangle.edgeSquaredLengths[1], base, velocity, velocitySquaredLength, t, newT, foundCollision, collisionPoint);
 				// p3 -> p1
-				check_edges(p3, p1, base, velocity, velocitySquaredLength, t, newT, foundCollision, collisionPoint);
+				check_edges(p3, triangle.edges[2], triangle.edgeSquaredLengths[2], base, velocity, velocitySquaredLength, t, newT, foundCollision, collisionPoint);
 			}
 
 			// Set result:
 			if (foundCollision == true) {
-				// distance to collision: 't' is time of collision
-				float distToCollision = t * colPackage->velocity.length();
-				// Does this triangle qualify for the closest hit?
-				// it does if it's the first hit or the closest
-				if (colPackage->foundCollision == false ||
-					distToCollision < colPackage->nearestDistance) {
-					// Collision information nessesary for sliding
-					colPackage->nearestDistance = distToCollision;
-					colPackage->intersectionPoint = collisionPoint;
-					colPackage->foundCollision = true;
-				}
+				recordCollision(colPackage, t, collisionPoint);
 			}
 
 		} // if not backface
 	}
 
+	// Keep a triangle hit at time t if it is the closest one so far
+	static void recordCollision(std::unique_ptr<CollisionPackage>& colPackage, float t, const glm::vec3& collisionPoint)
+	{
+		// distance to collision: 't' is time of collision
+		float distToCollision = t * colPackage->velocity.length();
+		// Does this triangle qualify for the closest hit?
+		// it does if it's the first hit or the closest
+		if (colPackage->foundCollision == false ||
+			distToCollision < colPackage->nearestDistance) {
+			// Collision information nessesary for sliding
+			colPackage->nearestDistance = distToCollision;
+			colPackage->intersectionPoint = collisionPoint;
+			colPackage->foundCollision = true;
+		}
+	}
+
 
 	typedef unsigned int uint32;
 	#define in(a) ((uint32&) a)
@@ -225,7 +241,8 @@ public:
 
 	static void check_edges(
 		const glm::vec3& p1,
-		const glm::vec3& p2,
+		const glm::vec3& edge,
+		const float edgeSquaredLength,
 		const glm::vec3& base,
 		const glm::vec3& velocity,
 		const float velocitySquaredLength,
@@ -235,10 +252,8 @@ public:
 		glm::vec3& collisionPoint
 	) 
 	{
-		glm::vec3 edge = p2 - p1;
 		glm::vec3 baseToVertex = p1 - base;
 		
-		float edgeSquaredLength = glm::length2(edge);
 		float edgeDotVelocity = glm::dot(edge, velocity);
 		float edgeDotBaseToVertex = glm::dot(edge, baseToVertex);
 		
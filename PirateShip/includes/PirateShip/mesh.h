@@ -5,10 +5,20 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <PirateShip/aabb.h>
+#include <PirateShip/instance_buffer.h>
+#include <PirateShip/material.h>
 #include <PirateShip/shader_m.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -31,10 +41,187 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// a simplified level of detail, a range of lodIndices over the same vertices as the full mesh
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;	// how far, in object space, the surface may be from the full mesh's
+};
+
+// mesh data as imported, before anything is uploaded to the GPU. textures only have their type and path set.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    // levels of detail, coarsest last
+    vector<unsigned int> lodIndices;
+    vector<MeshLod>      lods;
+};
+
+// what level of detail selection needs to know about the frame
+struct LodView {
+    glm::vec3 cameraPosition;
+    float pixelsPerUnit;	// pixels one world unit covers at distance one, viewport height / (2 tan(fovy / 2))
+    float maxPixelError = 1.0f;	// coarsest level whose error projects to at most this many pixels
+    float hysteresis = 0.25f;	// levels only change once the error is this fraction past the limit, so they don't flicker on it
+
+    static LodView perspective(const glm::vec3& cameraPosition, float fovy, float viewportHeight)
+    {
+        LodView view;
+        view.cameraPosition = cameraPosition;
+        view.pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovy * 0.5f));
+        return view;
+    }
+};
+
+// GPU vertex layout, picked per mesh when it is uploaded. attributes the mesh doesn't use are left out
+// (their shader inputs read the default 0) and the rest are quantised:
+//   0 position   3 x float
+//   1 normal     10:10:10:2 snorm
+//   2 texcoords  2 x half float, or 2 x float if half precision would move them by more than a quarter texel
+//   3 tangent    10:10:10:2 snorm, w holds the bitangent sign instead of a full bitangent
+//   5 bone ids   4 x ubyte, 6 bone weights 4 x unorm8, only for skinned meshes
+struct VertexFormat {
+    bool hasTexCoords = false;
+    bool halfTexCoords = false;
+    bool skinned = false;
+    unsigned int stride = 0;
+    unsigned int normalOffset = 0;
+    unsigned int texCoordOffset = 0;
+    unsigned int tangentOffset = 0;
+    unsigned int boneIdOffset = 0;
+    unsigned int boneWeightOffset = 0;
+
+    // smallest format that holds everything the vertices use. textureSize is the longer side, in texels, of the largest
+    // texture the vertices are sampled with, 0 if it isn't known, which keeps the texture coordinates in full floats
+    static VertexFormat choose(const vector<Vertex>& vertices, int textureSize)
+    {
+        VertexFormat format;
+        float largestTexCoord = 0.0f;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            const Vertex& vertex = vertices[i];
+            if (vertex.TexCoords.x != 0.0f || vertex.TexCoords.y != 0.0f)
+                format.hasTexCoords = true;
+            largestTexCoord = std::max(largestTexCoord, std::max(std::fabs(vertex.TexCoords.x), std::fabs(vertex.TexCoords.y)));
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+            {
+                if (vertex.m_Weights[j] != 0.0f)
+                    format.skinned = true;
+            }
+        }
+        // rounding moves a coordinate by up to half a step, which has to stay within a quarter of a texel
+        format.halfTexCoords = textureSize > 0 && halfStep(largestTexCoord) * textureSize <= 0.5f;
+
+        format.stride = sizeof(glm::vec3);
+        format.normalOffset = format.stride;
+        format.stride += 4;
+        // tangents are only generated for meshes with texture coordinates
+        if (format.hasTexCoords)
+        {
+            format.texCoordOffset = format.stride;
+            format.stride += format.halfTexCoords ? 4 : 8;
+            format.tangentOffset = format.stride;
+            format.stride += 4;
+        }
+        if (format.skinned)
+        {
+            format.boneIdOffset = format.stride;
+            format.stride += 4;
+            format.boneWeightOffset = format.stride;
+            format.stride += 4;
+        }
+        return format;
+    }
+
+    // distance between neighbouring half floats at value, 2^-10 in [1, 2), 2^-11 in [0.5, 1) and so on
+    static float halfStep(float value)
+    {
+        int exponent;
+        std::frexp(value, &exponent);
+        return std::ldexp(1.0f, std::max(exponent - 11, -24));
+    }
+
+    // interleave the vertices into this format
+    vector<unsigned char> pack(const vector<Vertex>& vertices) const
+    {
+        vector<unsigned char> data(vertices.size() * stride);
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            const Vertex& vertex = vertices[i];
+            unsigned char* out = &data[i * stride];
+            memcpy(out, &vertex.Position, sizeof(glm::vec3));
+            store(out + normalOffset, packSnorm1010102(vertex.Normal, 1.0f));
+            if (hasTexCoords)
+            {
+                if (halfTexCoords)
+                    store(out + texCoordOffset, glm::packHalf2x16(vertex.TexCoords));
+                else
+                    memcpy(out + texCoordOffset, &vertex.TexCoords, sizeof(glm::vec2));
+                // handedness of the tangent frame, so shaders can rebuild the bitangent as cross(N, T) * w
+                float sign = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                store(out + tangentOffset, packSnorm1010102(vertex.Tangent, sign));
+            }
+            if (skinned)
+            {
+                for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                {
+                    out[boneIdOffset + j] = (unsigned char)vertex.m_BoneIDs[j];
+                    out[boneWeightOffset + j] = (unsigned char)std::lround(glm::clamp(vertex.m_Weights[j], 0.0f, 1.0f) * 255.0f);
+                }
+            }
+        }
+        return data;
+    }
+
+    // point the attributes of the bound VAO at the bound vertex buffer
+    void setAttributes() const
+    {
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)normalOffset);
+        if (hasTexCoords)
+        {
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)(size_t)texCoordOffset);
+            // vertex tangent, w is the bitangent sign
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)tangentOffset);
+        }
+        if (skinned)
+        {
+            // ids
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)(size_t)boneIdOffset);
+            // weights
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)boneWeightOffset);
+        }
+    }
+
+    // x, y, z in 10 bits each and a sign in the top 2, the layout GL_INT_2_10_10_10_REV reads
+    static uint32_t packSnorm1010102(const glm::vec3& v, float w)
+    {
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int32_t component = (int32_t)std::lround(glm::clamp(v[i], -1.0f, 1.0f) * 511.0f);
+            packed |= ((uint32_t)component & 0x3FF) << (10 * i);
+        }
+        // 1 and -2 read back as 1 and -1 under both the GL 3.3 and the 4.2 snorm conversion
+        packed |= (w < 0.0f ? 2u : 1u) << 30;
+        return packed;
+    }
+
+private:
+    static void store(unsigned char* out, uint32_t value)
+    {
+        memcpy(out, &value, sizeof(value));
+    }
 };
 
 class Mesh {
@@ -43,63 +230,136 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    vector<unsigned int> lodIndices;
+    vector<MeshLod>      lods;
+    // the textures again, with their sampler names, shared by the model's meshes that use the same ones
+    std::shared_ptr<Material> material;
+    unsigned int VAO = 0;
+    // counts survive releaseGeometry()
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    // bounding box and sphere in object space
+    AABB bounds;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    // false if a FrustumCuller found the mesh outside the view, the model skips it until the next cull
+    bool visible = true;
+    // texture coordinates per object space unit, averaged over the surface, for texture streaming
+    float texCoordDensity = 0.0f;
+    // level of detail Draw uses, 0 is the full mesh
+    unsigned int lod = 0;
+    // layout and size of the vertex buffer on the GPU
+    VertexFormat format;
+    size_t vertexBufferSize = 0;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, upload is false when the mesh is drawn from a model's shared GeometryBatch instead of its own buffers.
+    // pass the vectors with std::move to hand them over without a copy.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        setup(upload);
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // constructor from imported data, levels of detail included
+    Mesh(MeshData data, bool upload = true)
+    {
+        vertices = std::move(data.vertices);
+        indices = std::move(data.indices);
+        textures = std::move(data.textures);
+        lodIndices = std::move(data.lodIndices);
+        lods = std::move(data.lods);
+        setup(upload);
     }
 
-    // render the mesh
-    void Draw(Shader& shader)
+    // levels of detail, 0 is the full mesh and 1 to lods.size() the simplified ones. firstIndex is into the element buffer.
+    unsigned int levelCount() const { return (unsigned int)lods.size() + 1; }
+    unsigned int levelFirstIndex(unsigned int level) const { return level == 0 ? 0 : indexCount + lods[level - 1].firstIndex; }
+    unsigned int levelIndexCount(unsigned int level) const { return level == 0 ? indexCount : lods[level - 1].indexCount; }
+    float levelError(unsigned int level) const { return level == 0 ? 0.0f : lods[level - 1].error; }
+
+    // picks the coarsest level whose error, projected from the mesh's nearest point, stays under view.maxPixelError
+    void selectLod(const LodView& view, const glm::mat4& model)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
+        if (lods.empty())
+            return;
+
+        float pixelsPerError = pixelsPerUnit(view, model);
+
+        while (lod > 0 && levelError(lod) * pixelsPerError > view.maxPixelError * (1.0f + view.hysteresis))
+            lod--;
+        while (lod + 1 < levelCount() && levelError(lod + 1) * pixelsPerError < view.maxPixelError * (1.0f - view.hysteresis))
+            lod++;
+    }
+
+    // longer side of the largest texture the mesh samples, 0 if it has none or one isn't loaded
+    int textureSize() const
+    {
+        int size = 0;
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            if (textures[i].size == 0)
+                return 0;
+            size = std::max(size, textures[i].size);
         }
+        return size;
+    }
+
+    // texture coordinates a pixel spans on the mesh's nearest point, how finely its textures will be sampled at most
+    float texCoordsPerPixel(const LodView& view, const glm::mat4& model) const
+    {
+        return texCoordDensity / pixelsPerUnit(view, model);
+    }
+
+    // render the mesh
+    void Draw(Shader& shader)
+    {
+        material->bind(shader);
 
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, levelIndexCount(lod), GL_UNSIGNED_INT, (void*)(levelFirstIndex(lod) * sizeof(unsigned int)));
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render every instance in the buffer with one draw call, at the level of detail last selected
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances)
+    {
+        material->bind(shader);
+
+        glBindVertexArray(VAO);
+        instances.bind();
+        glDrawElementsInstanced(GL_TRIANGLES, levelIndexCount(lod), GL_UNSIGNED_INT, (void*)(levelFirstIndex(lod) * sizeof(unsigned int)), (GLsizei)instances.size());
+        instances.unbind();
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // frees the CPU copy of the vertices and indices once they are on the GPU
+    void releaseGeometry()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+        vector<unsigned int>().swap(lodIndices);
+    }
+
+    // CPU memory held by the vertices and indices
+    size_t geometryBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + (indices.capacity() + lodIndices.capacity()) * sizeof(unsigned int);
+    }
+
     // render the mesh
     void Draw2(Shader& shader)
     {
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, levelIndexCount(lod), GL_UNSIGNED_INT, (void*)(levelFirstIndex(lod) * sizeof(unsigned int)));
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -108,7 +368,52 @@ public:
 
 private:
     // render data 
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+
+    // pixels an object space unit covers on the mesh's nearest point
+    float pixelsPerUnit(const LodView& view, const glm::mat4& model) const
+    {
+        // largest axis scale, so the error and radius stay conservative under non uniform scale
+        float scale = std::sqrt(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+            std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])))));
+        glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+        float distance = std::max(glm::length(center - view.cameraPosition) - boundsRadius * scale, 1e-3f);
+        return scale * view.pixelsPerUnit / distance;
+    }
+
+    // material, counts and bounds, then the GPU buffers if the mesh draws itself
+    void setup(bool upload)
+    {
+        material = std::make_shared<Material>(textures);
+        vertexCount = (unsigned int)vertices.size();
+        indexCount = (unsigned int)indices.size();
+        if (!vertices.empty())
+        {
+            for (unsigned int i = 0; i < vertices.size(); i++)
+                bounds.expand(vertices[i].Position);
+            boundsCenter = bounds.center();
+            for (unsigned int i = 0; i < vertices.size(); i++)
+                boundsRadius = std::max(boundsRadius, glm::length(vertices[i].Position - boundsCenter));
+
+            // ratio of texture coordinate area to surface area over the triangles
+            float surfaceArea = 0.0f, texCoordArea = 0.0f;
+            for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
+            {
+                const Vertex& a = vertices[indices[i]];
+                const Vertex& b = vertices[indices[i + 1]];
+                const Vertex& c = vertices[indices[i + 2]];
+                surfaceArea += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+                glm::vec2 u = b.TexCoords - a.TexCoords, v = c.TexCoords - a.TexCoords;
+                texCoordArea += std::abs(u.x * v.y - u.y * v.x);
+            }
+            if (surfaceArea > 0.0f)
+                texCoordDensity = std::sqrt(texCoordArea / surfaceArea);
+        }
+
+        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        if (upload)
+            setupMesh();
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -119,39 +424,21 @@ private:
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
-        // load data into vertex buffers
+        // pack the vertices into the smallest layout this mesh needs and load them into the vertex buffer
+        format = VertexFormat::choose(vertices, textureSize());
+        vector<unsigned char> packed = format.pack(vertices);
+        vertexBufferSize = packed.size();
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
 
+        // the full mesh's indices, followed by those of its levels of detail
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (indices.size() + lodIndices.size()) * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(unsigned int), indices.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), lodIndices.size() * sizeof(unsigned int), lodIndices.data());
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-        // ids
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-        // weights
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        format.setAttributes();
         glBindVertexArray(0);
     }
 };
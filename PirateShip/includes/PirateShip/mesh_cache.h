@@ -0,0 +1,354 @@
+#pragma once
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <PirateShip/mesh.h>
+
+// Read-only view of a whole file mapped into memory
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			close();
+			return false;
+		}
+		length = (size_t)fileSize.QuadPart;
+#else
+		int descriptor = ::open(path.c_str(), O_RDONLY);
+		if (descriptor < 0)
+			return false;
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+			::close(descriptor);
+			return false;
+		}
+		void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		// The mapping keeps the file alive on its own
+		::close(descriptor);
+		if (address == MAP_FAILED)
+			return false;
+		view = (const char*)address;
+		length = (size_t)info.st_size;
+#endif
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (view)
+			UnmapViewOfFile(view);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (view)
+			munmap((void*)view, length);
+#endif
+		view = nullptr;
+		length = 0;
+	}
+
+	const char* data() const { return view; }
+	size_t size() const { return length; }
+
+private:
+	const char* view = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+};
+
+// What a cache built from a source file checks to tell whether the source has changed
+struct SourceInfo {
+	uint64_t size;
+	int64_t time;
+
+	// Size and modification time of source, false if it can't be read
+	static bool read(const std::string& source, SourceInfo& info)
+	{
+#ifdef _WIN32
+		struct _stat64 status;
+		if (_stat64(source.c_str(), &status) != 0)
+			return false;
+#else
+		struct stat status;
+		if (stat(source.c_str(), &status) != 0)
+			return false;
+#endif
+		info.size = (uint64_t)status.st_size;
+		info.time = (int64_t)status.st_mtime;
+		return true;
+	}
+
+	// 64-bit FNV-1a of the whole file
+	static uint64_t hash(const std::string& path)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		MappedFile file;
+		if (!file.open(path))
+			return hash;
+		for (size_t i = 0; i < file.size(); i++) {
+			hash ^= (unsigned char)file.data()[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+};
+
+// Binary copy of a model's imported meshes, stored next to the source file.
+// Loading one is a memory map and a copy per mesh, none of Assimp's parsing or post-processing.
+class MeshCache
+{
+public:
+	// Bump whenever the file layout, Vertex or the import post-processing changes
+	static const uint32_t version = 4;
+
+	static std::string cachePath(const std::string& source) { return source + ".meshcache"; }
+
+	// Fill meshes from the cache of source, false if there is none or it is out of date
+	static bool load(const std::string& source, std::vector<MeshData>& meshes)
+	{
+		SourceInfo info;
+		if (!SourceInfo::read(source, info))
+			return false;
+
+		std::string path = cachePath(source);
+		Header header;
+		{
+			MappedFile file;
+			if (!file.open(path))
+				return false;
+
+			Reader reader{ file.data(), file.data() + file.size() };
+			if (!reader.read(header) || !current(header) || header.sourceSize != info.size)
+				return false;
+			if (header.meshCount > file.size() / sizeof(MeshHeader)) {
+				std::cout << "ERROR::MESH_CACHE::CORRUPT " << path << std::endl;
+				return false;
+			}
+
+			// A touched but unchanged source (a fresh checkout, say) is still good if its contents hash the same
+			if (header.sourceTime != info.time && header.sourceHash != SourceInfo::hash(source))
+				return false;
+
+			std::vector<MeshData> loaded(header.meshCount);
+			for (MeshData& mesh : loaded) {
+				if (!readMesh(reader, mesh)) {
+					std::cout << "ERROR::MESH_CACHE::CORRUPT " << path << std::endl;
+					return false;
+				}
+			}
+			meshes.swap(loaded);
+		}
+
+		// Remember the new timestamp so the next launch can skip hashing
+		if (header.sourceTime != info.time) {
+			header.sourceTime = info.time;
+			std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+			file.write((const char*)&header, sizeof(header));
+		}
+		return true;
+	}
+
+	// Write meshes imported from source into its cache
+	static bool save(const std::string& source, const std::vector<MeshData>& meshes)
+	{
+		SourceInfo info;
+		if (!SourceInfo::read(source, info))
+			return false;
+
+		Header header;
+		memcpy(header.magic, magic(), sizeof(header.magic));
+		header.version = version;
+		header.vertexSize = sizeof(Vertex);
+		header.meshCount = (uint32_t)meshes.size();
+		header.sourceSize = info.size;
+		header.sourceTime = info.time;
+		header.sourceHash = SourceInfo::hash(source);
+
+		std::string path = cachePath(source);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cout << "ERROR::MESH_CACHE::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		for (const MeshData& mesh : meshes) {
+			MeshHeader meshHeader = { (uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size(), (uint32_t)mesh.textures.size(),
+				(uint32_t)mesh.lodIndices.size(), (uint32_t)mesh.lods.size(), 0 };
+			file.write((const char*)&meshHeader, sizeof(meshHeader));
+			file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+			file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+			file.write((const char*)mesh.lodIndices.data(), mesh.lodIndices.size() * sizeof(unsigned int));
+			file.write((const char*)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+			for (const Texture& texture : mesh.textures) {
+				writeString(file, texture.type);
+				writeString(file, texture.path);
+			}
+		}
+
+		if (!file) {
+			// Never leave a half written cache behind
+			file.close();
+			remove(path.c_str());
+			std::cout << "ERROR::MESH_CACHE::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexSize;
+		uint32_t meshCount;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t sourceHash;
+	};
+
+	struct MeshHeader {
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t textureCount;
+		uint32_t lodIndexCount;
+		uint32_t lodCount;
+		uint32_t padding;
+	};
+
+	// Bounds checked cursor over the mapped file
+	struct Reader {
+		const char* position;
+		const char* end;
+
+		bool read(void* out, size_t bytes)
+		{
+			if ((size_t)(end - position) < bytes)
+				return false;
+			memcpy(out, position, bytes);
+			position += bytes;
+			return true;
+		}
+
+		template<class T>
+		bool read(T& out) { return read(&out, sizeof(T)); }
+	};
+
+	static const char* magic() { return "PSMC"; }
+
+	static bool current(const Header& header)
+	{
+		return memcmp(header.magic, magic(), sizeof(header.magic)) == 0 &&
+			header.version == version &&
+			header.vertexSize == sizeof(Vertex);
+	}
+
+	static bool readMesh(Reader& reader, MeshData& mesh)
+	{
+		MeshHeader header;
+		if (!reader.read(header))
+			return false;
+
+		// Check the counts against what is left before allocating anything
+		uint64_t bytes = (uint64_t)header.vertexCount * sizeof(Vertex) + ((uint64_t)header.indexCount + header.lodIndexCount) * sizeof(unsigned int) +
+			(uint64_t)header.lodCount * sizeof(MeshLod) + (uint64_t)header.textureCount * 8;
+		if (bytes > (uint64_t)(reader.end - reader.position))
+			return false;
+
+		mesh.vertices.resize(header.vertexCount);
+		mesh.indices.resize(header.indexCount);
+		mesh.lodIndices.resize(header.lodIndexCount);
+		mesh.lods.resize(header.lodCount);
+		mesh.textures.resize(header.textureCount);
+		if (!reader.read(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) ||
+			!reader.read(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int)) ||
+			!reader.read(mesh.lodIndices.data(), mesh.lodIndices.size() * sizeof(unsigned int)) ||
+			!reader.read(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod)))
+			return false;
+
+		for (Texture& texture : mesh.textures) {
+			texture.id = 0;
+			if (!readString(reader, texture.type) || !readString(reader, texture.path))
+				return false;
+		}
+		return true;
+	}
+
+	// Length prefixed, padded to 4 bytes so the next mesh's vertices stay aligned
+	static void writeString(std::ofstream& file, const std::string& text)
+	{
+		uint32_t length = (uint32_t)text.size();
+		const char padding[4] = { 0, 0, 0, 0 };
+		file.write((const char*)&length, sizeof(length));
+		file.write(text.data(), text.size());
+		file.write(padding, (4 - text.size() % 4) % 4);
+	}
+
+	static bool readString(Reader& reader, std::string& text)
+	{
+		uint32_t length;
+		if (!reader.read(length) || (size_t)(reader.end - reader.position) < length)
+			return false;
+		text.assign(reader.position, length);
+		size_t padded = length + (4 - length % 4) % 4;
+		reader.position += padded < (size_t)(reader.end - reader.position) ? padded : (size_t)(reader.end - reader.position);
+		return true;
+	}
+};
+#endif
@@ -0,0 +1,184 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <PirateShip/mesh.h>
+#include <PirateShip/mesh_cache.h>
+#include <PirateShip/mesh_optimizer.h>
+#include <PirateShip/mesh_simplifier.h>
+
+#include <string>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Reads the meshes of a model file without touching OpenGL, so it can run headless or off the main thread.
+class MeshLoader
+{
+public:
+    // reads the meshes from the model's mesh cache, or imports them with ASSIMP and writes the cache for next time.
+    static bool load(string const& path, vector<MeshData>& meshes, bool* fromCache = nullptr)
+    {
+        if (MeshCache::load(path, meshes))
+        {
+            if (fromCache)
+                *fromCache = true;
+            return true;
+        }
+
+        if (fromCache)
+            *fromCache = false;
+        if (!import(path, meshes))
+            return false;
+        MeshCache::save(path, meshes);
+        return true;
+    }
+
+    // loads a model with supported ASSIMP extensions from file into meshes, reordered for the GPU and with levels of detail unless optimize is false.
+    static bool import(string const& path, vector<MeshData>& meshes, bool optimize = true)
+    {
+        // read file via ASSIMP
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+        // check for errors
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return false;
+        }
+
+        // process ASSIMP's root node recursively
+        meshes.clear();
+        meshes.reserve(scene->mNumMeshes);
+        processNode(scene->mRootNode, scene, meshes);
+
+        // reorder for the vertex cache, overdraw and vertex fetch and simplify once here, the mesh cache keeps the result
+        if (optimize)
+        {
+            for (unsigned int i = 0; i < meshes.size(); i++)
+            {
+                MeshOptimizer::optimize(meshes[i]);
+                MeshSimplifier::generateLods(meshes[i]);
+            }
+        }
+        return true;
+    }
+
+private:
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    static void processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshes)
+    {
+        // process each mesh located at the current node
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            // the node object only contains indices to index the actual objects in the scene.
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            meshes.push_back(processMesh(mesh, scene));
+        }
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+        {
+            processNode(node->mChildren[i], scene, meshes);
+        }
+    }
+
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene)
+    {
+        // data to fill
+        MeshData data;
+        data.vertices.reserve(mesh->mNumVertices);
+        data.indices.reserve(mesh->mNumFaces * 3); // triangulated
+
+        // walk through each of the mesh's vertices
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex vertex = {}; // zeroed, so unused attributes (like the bones of an unskinned mesh) read as absent
+            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            // positions
+            vector.x = mesh->mVertices[i].x;
+            vector.y = mesh->mVertices[i].y;
+            vector.z = mesh->mVertices[i].z;
+            vertex.Position = vector;
+            // normals
+            if (mesh->HasNormals())
+            {
+                vector.x = mesh->mNormals[i].x;
+                vector.y = mesh->mNormals[i].y;
+                vector.z = mesh->mNormals[i].z;
+                vertex.Normal = vector;
+            }
+            // texture coordinates
+            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            {
+                glm::vec2 vec;
+                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+                vec.x = mesh->mTextureCoords[0][i].x;
+                vec.y = mesh->mTextureCoords[0][i].y;
+                vertex.TexCoords = vec;
+                // tangent
+                vector.x = mesh->mTangents[i].x;
+                vector.y = mesh->mTangents[i].y;
+                vector.z = mesh->mTangents[i].z;
+                vertex.Tangent = vector;
+                // bitangent
+                vector.x = mesh->mBitangents[i].x;
+                vector.y = mesh->mBitangents[i].y;
+                vector.z = mesh->mBitangents[i].z;
+                vertex.Bitangent = vector;
+            }
+            else
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+
+            data.vertices.push_back(vertex);
+        }
+        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            aiFace face = mesh->mFaces[i];
+            // retrieve all indices of the face and store them in the indices vector
+            for (unsigned int j = 0; j < face.mNumIndices; j++)
+                data.indices.push_back(face.mIndices[j]);
+        }
+        // process materials
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+        // Same applies to other texture as the following list summarizes:
+        // diffuse: texture_diffuseN
+        // specular: texture_specularN
+        // normal: texture_normalN
+
+        // 1. diffuse maps
+        materialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
+        // 2. specular maps
+        materialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
+        // 3. normal maps
+        materialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
+        // 4. height maps
+        materialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
+
+        return data;
+    }
+
+    // lists the material textures of a given type, the model loads them once it has a GL context.
+    static void materialTextures(aiMaterial* mat, aiTextureType type, string typeName, vector<Texture>& textures)
+    {
+        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+    }
+};
+#endif
@@ -0,0 +1,301 @@
+#pragma once
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <PirateShip/mesh.h>
+
+// Post-transform vertex cache behaviour of an index buffer
+struct VertexCacheStats {
+	unsigned int transformed = 0;	// vertex shader invocations
+	float acmr = 0.0f;	// average cache miss ratio, transformed vertices per triangle (0.5 is ideal, 3 is no reuse)
+	float atvr = 0.0f;	// average transformed vertex ratio, transformed per unique vertex (1 is ideal)
+};
+
+// Import time reordering of a mesh's triangles and vertices for the GPU.
+// Runs once when Assimp imports a model, the mesh cache stores the result.
+class MeshOptimizer
+{
+public:
+	// Simulated post-transform cache, FIFO of this many vertices
+	static const unsigned int cacheSize = 32;
+
+	// Vertex cache order, then overdraw order that keeps most of its locality, then vertex fetch order.
+	// Meshes with anything but triangles are left alone.
+	static void optimize(MeshData& mesh, float overdrawThreshold = 1.05f)
+	{
+		if (mesh.indices.empty() || mesh.indices.size() % 3 != 0)
+			return;
+		optimizeVertexCache(mesh.indices, mesh.vertices.size());
+		optimizeOverdraw(mesh.indices, mesh.vertices, overdrawThreshold);
+		optimizeVertexFetch(mesh.vertices, mesh.indices);
+	}
+
+	static VertexCacheStats analyze(const std::vector<unsigned int>& indices, size_t vertexCount)
+	{
+		VertexCacheStats stats;
+		if (indices.empty() || vertexCount == 0)
+			return stats;
+
+		Cache cache(vertexCount);
+		for (size_t i = 0; i < indices.size(); i += 3)
+			stats.transformed += cache.triangle(&indices[i]);
+		stats.acmr = (float)stats.transformed / (float)(indices.size() / 3);
+		stats.atvr = (float)stats.transformed / (float)vertexCount;
+		return stats;
+	}
+
+	// Tom Forsyth's linear-speed vertex cache optimisation: greedily emit the triangle whose vertices
+	// score best, favouring vertices recently used and vertices with few triangles left.
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Triangles using each vertex, the first liveTriangles[v] of them not emitted yet
+		std::vector<unsigned int> offsets(vertexCount + 1, 0);
+		for (unsigned int index : indices)
+			offsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		std::vector<unsigned int> adjacency(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+		std::vector<unsigned int> liveTriangles(vertexCount);
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			liveTriangles[v] = offsets[v + 1] - offsets[v];
+			vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		std::vector<char> emitted(triangleCount, 0);
+		for (size_t t = 0; t < triangleCount; t++)
+			triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+		std::vector<unsigned int> cache, nextCache;
+		cache.reserve(cacheSize + 3);
+		nextCache.reserve(cacheSize + 3);
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+
+		size_t cursor = 0;
+		long long best = -1;
+		while (result.size() < indices.size()) {
+			// Nothing in the cache to continue from, start again at the next triangle in file order
+			if (best < 0) {
+				while (emitted[cursor])
+					cursor++;
+				best = (long long)cursor;
+			}
+
+			const unsigned int* triangle = &indices[(size_t)best * 3];
+			emitted[(size_t)best] = 1;
+			nextCache.clear();
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = triangle[k];
+				result.push_back(v);
+				nextCache.push_back(v);
+
+				// Drop the triangle from the vertex's live list
+				unsigned int* live = &adjacency[offsets[v]];
+				for (unsigned int j = 0; j < liveTriangles[v]; j++) {
+					if (live[j] == (unsigned int)best) {
+						live[j] = live[liveTriangles[v] - 1];
+						break;
+					}
+				}
+				liveTriangles[v]--;
+			}
+			for (unsigned int v : cache) {
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+					nextCache.push_back(v);
+			}
+
+			// Rescore everything that moved in or fell out of the cache, and their triangles with them
+			for (size_t i = 0; i < nextCache.size(); i++) {
+				unsigned int v = nextCache[i];
+				cachePosition[v] = i < cacheSize ? (int)i : -1;
+				float score = vertexScore(cachePosition[v], liveTriangles[v]);
+				float delta = score - vertexScores[v];
+				vertexScores[v] = score;
+				const unsigned int* live = &adjacency[offsets[v]];
+				for (unsigned int j = 0; j < liveTriangles[v]; j++)
+					triangleScores[live[j]] += delta;
+			}
+			if (nextCache.size() > cacheSize)
+				nextCache.resize(cacheSize);
+			cache.swap(nextCache);
+
+			// Best triangle that shares a vertex with the cache
+			best = -1;
+			float bestScore = -1.0f;
+			for (unsigned int v : cache) {
+				const unsigned int* live = &adjacency[offsets[v]];
+				for (unsigned int j = 0; j < liveTriangles[v]; j++) {
+					if (triangleScores[live[j]] > bestScore) {
+						bestScore = triangleScores[live[j]];
+						best = live[j];
+					}
+				}
+			}
+		}
+		indices.swap(result);
+	}
+
+	// Sander, Nehab and Barczak's linear-speed overdraw ordering: split the cache optimised triangles
+	// into clusters where the cache restarts anyway, or where splitting keeps the ACMR within
+	// threshold, then draw the clusters that face away from the mesh centre first.
+	static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Hard boundaries, triangles that miss the cache with all three vertices
+		std::vector<size_t> hardClusters;
+		Cache cache(vertices.size());
+		for (size_t t = 0; t < triangleCount; t++) {
+			unsigned int misses = cache.triangle(&indices[t * 3]);
+			if (t == 0 || misses == 3)
+				hardClusters.push_back(t);
+		}
+		hardClusters.push_back(triangleCount);
+
+		// Soft boundaries inside them, wherever the ACMR so far is already close to the whole cluster's
+		std::vector<size_t> clusters;
+		for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+			size_t start = hardClusters[c], end = hardClusters[c + 1];
+			cache.flush();
+			unsigned int clusterMisses = 0;
+			for (size_t t = start; t < end; t++)
+				clusterMisses += cache.triangle(&indices[t * 3]);
+			float limit = threshold * (float)clusterMisses / (float)(end - start);
+
+			cache.flush();
+			clusters.push_back(start);
+			size_t from = start;
+			unsigned int misses = 0;
+			for (size_t t = start; t < end; t++) {
+				misses += cache.triangle(&indices[t * 3]);
+				if (t + 1 < end && (float)misses <= limit * (float)(t + 1 - from)) {
+					clusters.push_back(t + 1);
+					from = t + 1;
+					misses = 0;
+					cache.flush();
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		glm::vec3 meshCentroid(0.0f);
+		for (const Vertex& vertex : vertices)
+			meshCentroid += vertex.Position;
+		meshCentroid /= (float)std::max<size_t>(vertices.size(), 1);
+
+		// Clusters facing out from the centre are likely to occlude the rest, so sort them first
+		std::vector<float> sortKeys(clusters.size() - 1);
+		for (size_t c = 0; c + 1 < clusters.size(); c++) {
+			glm::vec3 centroid(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+				const glm::vec3& a = vertices[indices[t * 3]].Position;
+				const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+				const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+				glm::vec3 weighted = glm::cross(b - a, d - a);
+				float triangleArea = glm::length(weighted);
+				centroid += (a + b + d) * (triangleArea / 3.0f);
+				normal += weighted;
+				area += triangleArea;
+			}
+			if (area > 0.0f)
+				centroid /= area;
+			float length = glm::length(normal);
+			if (length > 0.0f)
+				normal /= length;
+			sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+		}
+
+		std::vector<size_t> order(sortKeys.size());
+		for (size_t c = 0; c < order.size(); c++)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (size_t c : order)
+			result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+		indices.swap(result);
+	}
+
+	// Renumber vertices in the order the triangles first use them, so vertex fetch streams through
+	// memory. Vertices no triangle uses are dropped.
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		const unsigned int unused = ~0u;
+		std::vector<unsigned int> remap(vertices.size(), unused);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+		for (unsigned int& index : indices) {
+			if (remap[index] == unused) {
+				remap[index] = (unsigned int)reordered.size();
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(reordered);
+	}
+
+private:
+	// FIFO cache, a vertex is cached while fewer than cacheSize misses happened since its own
+	struct Cache {
+		std::vector<unsigned int> missTime;
+		unsigned int time = cacheSize + 1;
+
+		explicit Cache(size_t vertexCount) : missTime(vertexCount, 0) {}
+
+		// Misses of one triangle
+		unsigned int triangle(const unsigned int* indices)
+		{
+			unsigned int misses = 0;
+			for (int k = 0; k < 3; k++) {
+				if (time - missTime[indices[k]] > cacheSize) {
+					missTime[indices[k]] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+		void flush() { time += cacheSize + 1; }
+	};
+
+	static float vertexScore(int position, unsigned int liveTriangles)
+	{
+		// No triangles left, never pick it
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (position >= 0) {
+			// The last triangle's vertices score the same, whatever order they went in
+			if (position < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - (float)(position - 3) / (float)(cacheSize - 3), 1.5f);
+		}
+		// Finish off vertices with few triangles left before they get evicted
+		score += 2.0f / std::sqrt((float)liveTriangles);
+		return score;
+	}
+};
+#endif
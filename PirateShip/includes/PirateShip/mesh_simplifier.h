@@ -0,0 +1,289 @@
+#pragma once
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <PirateShip/mesh.h>
+#include <PirateShip/mesh_optimizer.h>
+
+// Garland and Heckbert quadric error simplification, restricted to collapsing a vertex onto one of its
+// neighbours. The vertices never change, so every level of detail is just another index buffer over
+// the mesh's vertex buffer.
+class MeshSimplifier
+{
+public:
+	// Fill mesh.lods with up to maxLevels successively coarser index buffers, each about ratio of the last.
+	// Stops early once a level would be under minTriangles or simplification stalls.
+	static void generateLods(MeshData& mesh, unsigned int maxLevels = 3, float ratio = 0.5f, size_t minTriangles = 64)
+	{
+		mesh.lodIndices.clear();
+		mesh.lods.clear();
+		if (mesh.indices.empty() || mesh.indices.size() % 3 != 0)
+			return;
+
+		std::vector<unsigned int> previous = mesh.indices;
+		float error = 0.0f;
+		for (unsigned int level = 0; level < maxLevels; level++) {
+			size_t target = (size_t)(previous.size() / 3 * ratio) * 3;
+			if (target / 3 < minTriangles)
+				break;
+
+			float levelError = 0.0f;
+			std::vector<unsigned int> simplified = simplify(mesh.vertices, previous, target, levelError);
+			// Locked seams and borders can leave too little to collapse for another level to be worth it
+			if (simplified.size() > previous.size() * 9 / 10)
+				break;
+
+			// Each level starts from the last, so their errors add up
+			error += levelError;
+			MeshOptimizer::optimizeVertexCache(simplified, mesh.vertices.size());
+			MeshLod lod = { (unsigned int)mesh.lodIndices.size(), (unsigned int)simplified.size(), error };
+			mesh.lods.push_back(lod);
+			mesh.lodIndices.insert(mesh.lodIndices.end(), simplified.begin(), simplified.end());
+			previous.swap(simplified);
+		}
+	}
+
+	// Collapse edges, cheapest first, until at most targetIndexCount indices are left or nothing can collapse.
+	// error is set to the largest object space distance, RMS over the merged planes, a collapse moved the surface.
+	static std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float& error)
+	{
+		std::vector<unsigned int> result = indices;
+		error = 0.0f;
+		if (result.size() <= targetIndexCount)
+			return result;
+
+		std::vector<bool> locked = lockedVertices(vertices, result);
+
+		// Planes of the triangles around each vertex
+		std::vector<Quadric> quadrics(vertices.size());
+		for (size_t i = 0; i < result.size(); i += 3) {
+			Quadric quadric = Quadric::triangle(vertices[result[i]].Position, vertices[result[i + 1]].Position, vertices[result[i + 2]].Position);
+			for (int k = 0; k < 3; k++)
+				quadrics[result[i + k]].add(quadric);
+		}
+
+		std::vector<Collapse> candidates;
+		std::vector<unsigned int> remap(vertices.size());
+		std::vector<bool> touched(vertices.size());
+		std::vector<unsigned int> offsets, adjacency;
+		double maxCost = 0.0;
+
+		while (result.size() > targetIndexCount) {
+			buildAdjacency(result, vertices.size(), offsets, adjacency);
+
+			// Every unlocked vertex can go to any neighbour
+			candidates.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+					if (!locked[a])
+						candidates.push_back(collapse(a, b, vertices, quadrics));
+					if (!locked[b])
+						candidates.push_back(collapse(b, a, vertices, quadrics));
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+			// Most collapses remove two triangles, so do about half the excess this pass.
+			// Vertices next to a collapse wait for the next pass, where their neighbourhood is up to date.
+			size_t needed = ((result.size() - targetIndexCount) / 3 + 1) / 2;
+			size_t collapses = 0;
+			for (unsigned int v = 0; v < remap.size(); v++)
+				remap[v] = v;
+			std::fill(touched.begin(), touched.end(), false);
+			for (const Collapse& candidate : candidates) {
+				if (collapses >= needed)
+					break;
+				if (touched[candidate.from] || touched[candidate.to] || flips(candidate, vertices, result, offsets, adjacency))
+					continue;
+
+				remap[candidate.from] = candidate.to;
+				quadrics[candidate.to].add(quadrics[candidate.from]);
+				for (unsigned int j = offsets[candidate.from]; j < offsets[candidate.from + 1]; j++) {
+					for (int k = 0; k < 3; k++)
+						touched[result[adjacency[j] * 3 + k]] = true;
+				}
+				maxCost = std::max(maxCost, candidate.cost);
+				collapses++;
+			}
+			if (collapses == 0)
+				break;
+
+			// Rewrite the triangles, dropping the ones that collapsed to an edge
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+				if (a == b || b == c || c == a)
+					continue;
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		error = (float)std::sqrt(maxCost);
+		return result;
+	}
+
+private:
+	// Symmetric 4x4 matrix of summed squared plane distances, with the total weight to average them
+	struct Quadric {
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0, weight = 0;
+
+		// Plane of a triangle, weighted by its area so slivers count for little
+		static Quadric triangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+		{
+			Quadric quadric;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			double length = glm::length(normal);
+			if (length == 0.0)
+				return quadric;
+			double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+			double d = -(a * p0.x + b * p0.y + c * p0.z);
+			double w = length * 0.5;
+			quadric.a2 = w * a * a; quadric.ab = w * a * b; quadric.ac = w * a * c; quadric.ad = w * a * d;
+			quadric.b2 = w * b * b; quadric.bc = w * b * c; quadric.bd = w * b * d;
+			quadric.c2 = w * c * c; quadric.cd = w * c * d;
+			quadric.d2 = w * d * d;
+			quadric.weight = w;
+			return quadric;
+		}
+
+		void add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			weight += other.weight;
+		}
+
+		// Mean squared distance of p to the planes
+		double error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z
+				+ d2;
+			return weight > 0 ? std::fabs(sum) / weight : 0.0;
+		}
+	};
+
+	struct Collapse {
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	static Collapse collapse(unsigned int from, unsigned int to, const std::vector<Vertex>& vertices, const std::vector<Quadric>& quadrics)
+	{
+		Quadric merged = quadrics[from];
+		merged.add(quadrics[to]);
+		Collapse result = { from, to, merged.error(vertices[to].Position) };
+		return result;
+	}
+
+	// Vertices that must stay where they are: ones sharing their position with another vertex (a normal or UV seam),
+	// and ones on an open or non-manifold edge, so outlines and seams don't tear
+	static std::vector<bool> lockedVertices(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+	{
+		std::vector<bool> locked(vertices.size(), false);
+
+		// First vertex at each position
+		std::unordered_map<uint64_t, std::vector<unsigned int>> positions;
+		std::vector<unsigned int> position(vertices.size());
+		for (unsigned int v = 0; v < vertices.size(); v++) {
+			uint64_t key = positionHash(vertices[v].Position);
+			std::vector<unsigned int>& bucket = positions[key];
+			position[v] = v;
+			for (unsigned int other : bucket) {
+				if (vertices[other].Position == vertices[v].Position) {
+					position[v] = position[other];
+					locked[v] = locked[other] = true;
+					break;
+				}
+			}
+			bucket.push_back(v);
+		}
+
+		// Edges between positions that don't have exactly two triangles
+		std::unordered_map<uint64_t, unsigned int> edges;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = position[indices[i + k]], b = position[indices[i + (k + 1) % 3]];
+				edges[edgeKey(a, b)]++;
+			}
+		}
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+				if (edges[edgeKey(position[a], position[b])] != 2)
+					locked[a] = locked[b] = true;
+			}
+		}
+		return locked;
+	}
+
+	// Would moving from onto to turn any of from's remaining triangles over, or nearly?
+	static bool flips(const Collapse& candidate, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& adjacency)
+	{
+		for (unsigned int j = offsets[candidate.from]; j < offsets[candidate.from + 1]; j++) {
+			const unsigned int* triangle = &indices[adjacency[j] * 3];
+			if (triangle[0] == candidate.to || triangle[1] == candidate.to || triangle[2] == candidate.to)
+				continue;
+
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; k++) {
+				before[k] = vertices[triangle[k]].Position;
+				after[k] = triangle[k] == candidate.from ? vertices[candidate.to].Position : before[k];
+			}
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			// Turning further than about 75 degrees is folding over, or close enough to it over several passes
+			if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter))
+				return true;
+		}
+		return false;
+	}
+
+	// Triangles around each vertex, adjacency[offsets[v]] to adjacency[offsets[v + 1]]
+	static void buildAdjacency(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned int>& offsets, std::vector<unsigned int>& adjacency)
+	{
+		offsets.assign(vertexCount + 1, 0);
+		for (unsigned int index : indices)
+			offsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	static uint64_t edgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+	}
+
+	static uint64_t positionHash(const glm::vec3& p)
+	{
+		uint32_t x, y, z;
+		memcpy(&x, &p.x, 4);
+		memcpy(&y, &p.y, 4);
+		memcpy(&z, &p.z, 4);
+		return ((uint64_t)x * 73856093u) ^ ((uint64_t)y * 19349663u) ^ ((uint64_t)z * 83492791u);
+	}
+};
+#endif
@@ -6,12 +6,16 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb/stb_image.h>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
+#include <PirateShip/geometry_batch.h>
 #include <PirateShip/mesh.h>
+#include <PirateShip/mesh_loader.h>
+#include <PirateShip/render_queue.h>
 #include <PirateShip/shader_m.h>
+#include <PirateShip/texture.h>
+#include <PirateShip/texture_cache.h>
+#include <PirateShip/texture_compressor.h>
+#include <PirateShip/texture_streamer.h>
 
 #include <string>
 #include <fstream>
@@ -21,232 +25,399 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+// triangles submitted by model draws, main resets it every frame
+struct DrawStats {
+    unsigned int triangles = 0;
+    unsigned int fullTriangles = 0;	// what the same draws would have cost at full detail
+    unsigned int drawCalls = 0;
+
+    static DrawStats& frame()
+    {
+        static DrawStats stats;
+        return stats;
+    }
+};
+
+// what a model keeps of its meshes' CPU side geometry once it is on the GPU
+enum GeometryRetention {
+    RELEASE_GEOMETRY,	// render only, vertices and indices are freed after upload
+    KEEP_GEOMETRY		// read back later, for collision or picking
+};
+
+// a material texture an AssetLoader took from the texture cache before its model was uploaded
+struct MaterialImage {
+    TextureHandle texture;
+    EncodedImage image;	// filled by a worker if the loader was the first to ask for the texture
+    bool encode = false;
+    bool read = false;
+};
 
 class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    bool fromCache = false;	// true if the meshes came from the mesh cache instead of ASSIMP
+    GeometryBatch batch;	// shared buffers of all meshes on GL 4.3, empty when the meshes draw themselves
+    GeometryRetention retention;
+    size_t loadedGeometryBytes = 0;	// CPU geometry before the retention policy applied
+    bool loaded = false;	// false until the file has been read and uploaded, the model draws nothing until then
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, bool gamma = false, GeometryRetention retention = RELEASE_GEOMETRY) : gammaCorrection(gamma), retention(retention)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    // constructor for an empty model that an AssetLoader fills in with upload() once a worker has read its file.
+    explicit Model(GeometryRetention retention, bool gamma = false) : gammaCorrection(gamma), retention(retention)
+    {
+    }
+
+    // builds the meshes from data MeshLoader read from path and uploads them. textures found in images, keyed by
+    // imageKey, share the handle there and are uploaded from its image (through pixelBuffer, if given) instead of read from disk.
+    void upload(string const& path, vector<MeshData>& data, map<string, MaterialImage>* images = nullptr, unsigned int pixelBuffer = 0)
+    {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // with multi-draw indirect the meshes share the batch's buffers and don't upload their own
+        bool merged = GeometryBatch::supported();
+        meshes.reserve(data.size());
+        for (unsigned int i = 0; i < data.size(); i++)
+        {
+            vector<Texture> textures;
+            textures.reserve(data[i].textures.size());
+            for (unsigned int j = 0; j < data[i].textures.size(); j++)
+                textures.push_back(loadMaterialTexture(data[i].textures[j].path, data[i].textures[j].type, images, pixelBuffer));
+            // the loaded geometry moves straight into the mesh
+            data[i].textures = std::move(textures);
+            meshes.emplace_back(std::move(data[i]), !merged);
+        }
+        shareMaterials();
+        if (merged)
+            batch.build(meshes);
+
+        loadedGeometryBytes = geometryBytes();
+        if (retention == RELEASE_GEOMETRY)
+        {
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                meshes[i].releaseGeometry();
+        }
+        loaded = true;
+    }
+
+    // key of a material texture's encoded image, its type decides how it is compressed
+    static string imageKey(const string& type, const string& path)
+    {
+        return type + ' ' + path;
+    }
+
+    // meshes the frustum culler left visible
+    unsigned int visibleMeshes() const
+    {
+        unsigned int visible = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            visible += meshes[i].visible ? 1 : 0;
+        return visible;
+    }
+
+    // box around all meshes in object space, empty until the model is loaded
+    AABB bounds() const
+    {
+        AABB box;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!meshes[i].bounds.empty())
+                box.expand(meshes[i].bounds);
+        }
+        return box;
+    }
+
+    // CPU memory still held by the meshes' vertices and indices
+    size_t geometryBytes() const
+    {
+        size_t bytes = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            bytes += meshes[i].geometryBytes();
+        return bytes;
+    }
+
+    // draws the model, and thus all its meshes the frustum culler left visible, at the levels of detail last selected,
+    // with every texture level streamed in
     void Draw(Shader& shader)
     {
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            if (meshes[i].visible)
+                requestTextureLevels(meshes[i], 0.0f);
+        }
+        drawMeshes(shader);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw2(Shader& shader)
+    // draws the model with each mesh at the coarsest level of detail that looks the same from the view,
+    // and streams in the texture levels the view samples
+    void Draw(Shader& shader, const LodView& view, const glm::mat4& model)
     {
+        selectLod(view, model);
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw2(shader);
+        {
+            if (meshes[i].visible)
+                requestTextureLevels(meshes[i], meshes[i].texCoordsPerPixel(view, model));
+        }
+        drawMeshes(shader);
     }
 
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const& path)
+    // draws every instance in the buffer with the draw calls of a single model, at the levels of detail last selected.
+    // instances aren't culled, every mesh is drawn. the shader reads each instance's transform and material from the buffer instead of its model uniform.
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            requestTextureLevels(meshes[i], 0.0f);
+        drawMeshesInstanced(shader, instances);
+    }
+
+    // draws every instance in the buffer with the levels of detail and texture levels the nearest one needs
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, const LodView& view)
+    {
+        if (instances.size() == 0)
+            return;
+        const glm::mat4& nearest = instances.instances[instances.nearest(view.cameraPosition)].model;
+        swapInstancedLods();
+        selectLod(view, nearest);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            requestTextureLevels(meshes[i], meshes[i].texCoordsPerPixel(view, nearest));
+        drawMeshesInstanced(shader, instances);
+        swapInstancedLods();
+    }
+
+    // adds the meshes the frustum culler left visible to a render queue, as Draw with a view would draw them
+    void queue(RenderQueue& queue, Shader& shader, const LodView& view, const glm::mat4& model)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
-        // check for errors
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        selectLod(view, model);
+        for (unsigned int i = 0; i < meshes.size(); i++)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            if (meshes[i].visible)
+                requestTextureLevels(meshes[i], meshes[i].texCoordsPerPixel(view, model));
+        }
+        countDraw(batch.empty() ? visibleMeshes() : batch.drawCalls(), 1, true);
+
+        unsigned int transform = queue.addTransform(model);
+        if (!batch.empty())
+        {
+            for (size_t group = 0; group < batch.drawCalls(); group++)
+                queue.add(shader, batch, meshes, group, transform);
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (meshes[i].visible)
+                queue.add(shader, meshes[i], transform);
+        }
+    }
+
+    // adds every instance to a render queue, as DrawInstanced with a view would draw them
+    void queueInstanced(RenderQueue& queue, Shader& shader, const InstanceBuffer& instances, const LodView& view)
+    {
+        if (instances.size() == 0)
+            return;
+        const glm::mat4& nearest = instances.instances[instances.nearest(view.cameraPosition)].model;
+        swapInstancedLods();
+        selectLod(view, nearest);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            requestTextureLevels(meshes[i], meshes[i].texCoordsPerPixel(view, nearest));
+        countDraw(batch.empty() ? meshes.size() : batch.drawCalls(), instances.size(), false);
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // the queue records the levels, so the single draw's can be put back straight away
+        if (!batch.empty())
+        {
+            for (size_t group = 0; group < batch.drawCalls(); group++)
+                queue.add(shader, batch, meshes, group, 0, &instances);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                queue.add(shader, meshes[i], 0, &instances);
+        }
+        swapInstancedLods();
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // draws the model, and thus all its meshes the frustum culler left visible, at the levels of detail last selected
+    void Draw2(Shader& shader)
     {
-        // process each mesh located at the current node
-        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        countDraw(batch.empty() ? visibleMeshes() : 1, 1, true);
+        if (!batch.empty())
         {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            batch.selectLevels(meshes, true);
+            batch.draw(shader, false);
+            return;
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
+        for (unsigned int i = 0; i < meshes.size(); i++)
         {
-            processNode(node->mChildren[i], scene);
+            if (meshes[i].visible)
+                meshes[i].Draw2(shader);
         }
+    }
 
+    void Draw2(Shader& shader, const LodView& view, const glm::mat4& model)
+    {
+        selectLod(view, model);
+        Draw2(shader);
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    void selectLod(const LodView& view, const glm::mat4& model)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].selectLod(view, model);
+    }
+
+private:
+    vector<unsigned int> instancedLods;	// levels of detail of the instanced draws, see swapInstancedLods
+
+    // the "instanced" uniform of each program the model has drawn instanced with, found once per program
+    struct InstancedUniform {
+        GLuint program;
+        Uniform<bool> instanced;
+    };
+    vector<InstancedUniform> instancedUniforms;
 
-        // walk through each of the mesh's vertices
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    const Uniform<bool>& instancedUniform(const Shader& shader)
+    {
+        for (unsigned int i = 0; i < instancedUniforms.size(); i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-            {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
-            }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
-        }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-        {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
-        }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
-    }
-
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+            if (instancedUniforms[i].program == shader.ID)
+                return instancedUniforms[i].instanced;
+        }
+        instancedUniforms.push_back(InstancedUniform{ shader.ID, shader.uniform<bool>("instanced") });
+        return instancedUniforms.back().instanced;
+    }
+
+    void drawMeshes(Shader& shader)
+    {
+        countDraw(batch.empty() ? visibleMeshes() : batch.drawCalls(), 1, true);
+        if (!batch.empty())
+        {
+            batch.selectLevels(meshes, true);
+            batch.draw(shader, true);
+            return;
+        }
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (meshes[i].visible)
+                meshes[i].Draw(shader);
+        }
+    }
+
+    // the instanced draws keep their own levels of detail, swapped into the meshes while they select and draw, so
+    // neither selection starts from the other's levels and the hysteresis holds for both
+    void swapInstancedLods()
+    {
+        instancedLods.resize(meshes.size(), 0);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            std::swap(meshes[i].lod, instancedLods[i]);
+    }
+
+    // meshes with the same textures share one material, so sorted draws and the batch's groups bind it once
+    void shareMaterials()
     {
-        vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        vector<std::shared_ptr<Material>> materials;
+        for (unsigned int i = 0; i < meshes.size(); i++)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
+            bool shared = false;
+            for (unsigned int j = 0; j < materials.size() && !shared; j++)
             {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                if (materials[j]->sameTextures(meshes[i].textures))
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    meshes[i].material = materials[j];
+                    shared = true;
                 }
             }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            if (!shared)
+                materials.push_back(meshes[i].material);
         }
-        return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // tells the texture streamer how finely the mesh's textures are about to be sampled
+    void requestTextureLevels(const Mesh& mesh, float texCoordsPerPixel)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        for (unsigned int i = 0; i < mesh.textures.size(); i++)
+        {
+            if (mesh.textures[i].handle)
+                TextureStreamer::instance().request(*mesh.textures[i].handle, texCoordsPerPixel);
+        }
+    }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    void drawMeshesInstanced(Shader& shader, const InstanceBuffer& instances)
+    {
+        if (instances.size() == 0)
+            return;
+        countDraw(batch.empty() ? meshes.size() : batch.drawCalls(), instances.size(), false);
+        const Uniform<bool>& instanced = instancedUniform(shader);
+        instanced.set(true);
+        if (!batch.empty())
+        {
+            batch.selectLevels(meshes, false);
+            batch.drawInstanced(shader, instances);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                meshes[i].DrawInstanced(shader, instances);
+        }
+        instanced.set(false);
+    }
 
-        stbi_image_free(data);
+    // culled skips the meshes the frustum culler hid, as the draw did
+    void countDraw(size_t drawCalls, size_t instances, bool culled) const
+    {
+        DrawStats& stats = DrawStats::frame();
+        stats.drawCalls += (unsigned int)drawCalls;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (culled && !meshes[i].visible)
+                continue;
+            stats.triangles += (unsigned int)(meshes[i].levelIndexCount(meshes[i].lod) / 3 * instances);
+            stats.fullTriangles += (unsigned int)(meshes[i].indexCount / 3 * instances);
+        }
     }
-    else
+
+    // loads the meshes of a model file and uploads them together with their textures.
+    void loadModel(string const& path)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        // read the meshes from the mesh cache, or with ASSIMP the first time
+        vector<MeshData> data;
+        if (!MeshLoader::load(path, data, &fromCache))
+            return;
+        upload(path, data);
     }
 
-    return textureID;
-}
+    // gets a material texture from the texture cache, which loads it only if nothing else holds it yet, and streams it.
+    // the required info is returned as a Texture struct.
+    Texture loadMaterialTexture(const string& path, const string& typeName, map<string, MaterialImage>* images, unsigned int pixelBuffer)
+    {
+        Texture texture;
+        TextureRole role = TextureCompressor::roleOf(typeName);
+        map<string, MaterialImage>::iterator image;
+        if (images && (image = images->find(imageKey(typeName, path))) != images->end())
+            texture.handle = image->second.texture;
+        if (texture.handle && image->second.encode)
+        {
+            // encoded by an AssetLoader worker, only the upload is left
+            if (!image->second.read)
+                std::cout << "Texture failed to load at path: " << directory << '/' << path << std::endl;
+            TextureStreamer::instance().fill(texture.handle, std::move(image->second.image), pixelBuffer);
+            image->second.encode = false;
+        }
+        // still on its way for someone else. the draws bind the id taken below, so read it here rather than wait
+        else if (!texture.handle || !texture.handle->loaded)
+            texture.handle = TextureStreamer::instance().load(directory + '/' + path, role);
+        texture.id = texture.handle->id;
+        texture.size = std::max(texture.handle->width, texture.handle->height);
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
+    }
+};
 #endif
@@ -0,0 +1,164 @@
+#pragma once
+#ifndef OCCLUSION_QUERY_H
+#define OCCLUSION_QUERY_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <PirateShip/aabb.h>
+#include <PirateShip/shader_m.h>
+
+// Whether an object was visible, from an occlusion query on a box around it drawn into the scene's depth buffer.
+// The answer is the newest query the GPU has finished, usually the previous frame's, so asking never stalls on the
+// current frame. Objects that come into view are drawn a frame late.
+class OcclusionQuery
+{
+public:
+	// Queries in flight at most. The GPU can run this many frames behind before a query is reused unread.
+	static const int queryCount = 3;
+
+	// Frames the object was found hidden, and asked about in total
+	unsigned int hiddenFrames = 0;
+	unsigned int frames = 0;
+
+	OcclusionQuery() {}
+	~OcclusionQuery()
+	{
+		if (queries[0] != 0)
+			glDeleteQueries(queryCount, queries);
+		if (VAO != 0) {
+			glDeleteVertexArrays(1, &VAO);
+			glDeleteBuffers(1, &VBO);
+			glDeleteBuffers(1, &EBO);
+		}
+	}
+
+	OcclusionQuery(const OcclusionQuery&) = delete;
+	OcclusionQuery& operator=(const OcclusionQuery&) = delete;
+
+	// Was the box visible when last tested? Call after test() and before drawing the object.
+	bool visible()
+	{
+		collect();
+		frames++;
+		if (!lastVisible)
+			hiddenFrames++;
+		return lastVisible;
+	}
+
+	// Draw the world space box without touching colour or depth, counting the samples that pass the depth test.
+	// shader draws positions with projection, view and model uniforms. From inside the box its far side can be hidden
+	// while the object is not, so the query is skipped and the object counts as visible.
+	void test(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition, const AABB& box, float margin)
+	{
+		if (box.empty() || AABB(box.min - margin, box.max + margin).contains(cameraPosition)) {
+			reset();
+			return;
+		}
+		if (VAO == 0)
+			createProxy();
+
+		// The oldest query is reused, whatever it would have said is older than anything the newer ones will
+		int slot = next;
+		next = (next + 1) % queryCount;
+
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), box.center());
+		model = glm::scale(model, box.extent() * 0.5f);
+		shader.use();
+		if (shader.ID != proxyShader) {
+			proxyShader = shader.ID;
+			projectionUniform = shader.uniform<glm::mat4>("projection");
+			viewUniform = shader.uniform<glm::mat4>("view");
+			modelUniform = shader.uniform<glm::mat4>("model");
+		}
+		projectionUniform.set(projection);
+		viewUniform.set(view);
+		modelUniform.set(model);
+
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[slot]);
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+		glBindVertexArray(0);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthMask(GL_TRUE);
+
+		issued[slot] = ++issueCount;
+	}
+
+	// Forget the queries in flight, the object counts as visible until a new one finishes
+	void reset()
+	{
+		for (int i = 0; i < queryCount; i++)
+			issued[i] = 0;
+		lastVisible = true;
+		newestRead = issueCount;
+	}
+
+private:
+	// Read the finished queries newer than the newest one read so far, keeping the newest answer.
+	// Slots go round, so they aren't in the order they were issued.
+	void collect()
+	{
+		for (int i = 0; i < queryCount; i++) {
+			if (issued[i] <= newestRead)
+				continue;
+			GLuint available = 0;
+			glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+			GLuint samples = 0;
+			glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &samples);
+			newestRead = issued[i];
+			lastVisible = samples != 0;
+			issued[i] = 0;
+		}
+	}
+
+	// Cube from -1 to 1, scaled onto the box
+	void createProxy()
+	{
+		glGenQueries(queryCount, queries);
+
+		static const float corners[] = {
+			-1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, 1.0f, -1.0f,   -1.0f, 1.0f, -1.0f,
+			-1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f, 1.0f,  1.0f,   -1.0f, 1.0f,  1.0f
+		};
+		static const unsigned char faces[] = {
+			0, 2, 1, 0, 3, 2,	// back
+			4, 5, 6, 4, 6, 7,	// front
+			0, 1, 5, 0, 5, 4,	// bottom
+			3, 7, 6, 3, 6, 2,	// top
+			0, 4, 7, 0, 7, 3,	// left
+			1, 2, 6, 1, 6, 5	// right
+		};
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glBindVertexArray(0);
+	}
+
+	GLuint queries[queryCount] = {};
+	unsigned int issued[queryCount] = {};	// order the queries were issued in, 0 if there is nothing to read
+	unsigned int issueCount = 0;
+	unsigned int newestRead = 0;	// queries issued up to here have been read, or are too old to matter
+	bool lastVisible = true;
+	int next = 0;
+	unsigned int VAO = 0, VBO = 0, EBO = 0;
+	// the proxy's uniforms, found for the shader it was last drawn with
+	GLuint proxyShader = 0;
+	Uniform<glm::mat4> projectionUniform, viewUniform, modelUniform;
+};
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <PirateShip/entity.h>
+
+// Lock-free single writer / single reader snapshot.
+// Three slots so the writer always has a free one to fill while the reader holds the newest,
+// neither side ever waits on the other.
+template<class T>
+class SnapshotBuffer
+{
+public:
+	explicit SnapshotBuffer(const T& initial)
+	{
+		for (T& slot : slots)
+			slot = initial;
+	}
+
+	// Writer: fill back() then publish it
+	T& back() { return slots[backIndex]; }
+
+	void publish()
+	{
+		unsigned int previous = middle.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+		backIndex = previous & indexMask;
+	}
+
+	// Reader: the most recently published value
+	const T& read()
+	{
+		if (middle.load(std::memory_order_relaxed) & freshBit) {
+			unsigned int previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+			frontIndex = previous & indexMask;
+		}
+		return slots[frontIndex];
+	}
+
+private:
+	static const unsigned int indexMask = 3;
+	static const unsigned int freshBit = 4;
+
+	T slots[3];
+	std::atomic<unsigned int> middle{ 1 };
+	// Only touched by the writer
+	unsigned int backIndex = 0;
+	// Only touched by the reader
+	unsigned int frontIndex = 2;
+};
+
+// State of the last two physics steps, enough for the renderer to interpolate between them
+struct PhysicsSnapshot {
+	glm::vec3 previousPosition;
+	glm::vec3 position;
+	// Seconds since the simulation started at which position was reached
+	double time;
+};
+
+// Steps an entity at a fixed rate on its own thread, so the simulation no longer depends on frame rate
+// and a slow collision step never holds up rendering.
+class PhysicsThread
+{
+public:
+	// Length of one step, the old per-frame gravity and damping now apply per step
+	const double stepSeconds;
+	// Most steps run back to back after a stall, anything older is dropped
+	static const int maxCatchUpSteps = 5;
+
+	PhysicsThread(const std::shared_ptr<CharacterEntity>& entity, double stepSeconds = 1.0 / 60.0)
+		: stepSeconds(stepSeconds), entity(entity), snapshots(PhysicsSnapshot{ entity->position, entity->position, 0.0 })
+	{
+	}
+
+	~PhysicsThread() { stop(); }
+
+	PhysicsThread(const PhysicsThread&) = delete;
+	PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+	// The entity belongs to the physics thread until stop()
+	void start()
+	{
+		if (running)
+			return;
+		running = true;
+		startTime = std::chrono::steady_clock::now();
+		thread = std::thread(&PhysicsThread::run, this);
+	}
+
+	void stop()
+	{
+		if (!running)
+			return;
+		running = false;
+		thread.join();
+	}
+
+	// Input from the render thread, picked up by the next step
+	void addVelocity(const glm::vec3& delta)
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		pendingVelocity += delta;
+	}
+
+	void setGravity(bool enabled) { gravity = enabled; }
+
+	// Seconds since start() on the clock the physics thread steps with
+	double now() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// One fixed step: take the input, collide and slide, then damp the velocity.
+	// Replays call this directly, so they step exactly like the game does.
+	static void step(CharacterEntity& entity, const glm::vec3& inputVelocity, bool useGravity)
+	{
+		entity.velocity += inputVelocity;
+		entity.update(useGravity);
+		entity.velocity = entity.velocity * .05f;
+	}
+
+	// Entity position blended between the last two steps, one step behind real time
+	glm::vec3 interpolatedPosition()
+	{
+		const PhysicsSnapshot& snapshot = snapshots.read();
+		float alpha = (float)((now() - snapshot.time) / stepSeconds);
+		alpha = glm::clamp(alpha, 0.0f, 1.0f);
+		return glm::mix(snapshot.previousPosition, snapshot.position, alpha);
+	}
+
+private:
+	std::shared_ptr<CharacterEntity> entity;
+	SnapshotBuffer<PhysicsSnapshot> snapshots;
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> gravity{ true };
+	std::chrono::steady_clock::time_point startTime;
+
+	std::mutex inputMutex;
+	glm::vec3 pendingVelocity = glm::vec3(0.0f);
+
+	void run()
+	{
+		auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(stepSeconds));
+		auto nextStep = startTime + step;
+
+		while (running) {
+			// Catch up on the steps that are due, then sleep until the next one
+			int caughtUp = 0;
+			while (std::chrono::steady_clock::now() >= nextStep && running) {
+				// Too far behind to catch up, drop the backlog rather than fall further behind every wake-up
+				if (caughtUp == maxCatchUpSteps) {
+					nextStep = std::chrono::steady_clock::now() + step;
+					break;
+				}
+
+				glm::vec3 previousPosition = entity->position;
+				simulate();
+				caughtUp++;
+
+				// Stamped with the step's scheduled time, so interpolation stays in line with now() after a drop
+				PhysicsSnapshot& snapshot = snapshots.back();
+				snapshot.previousPosition = previousPosition;
+				snapshot.position = entity->position;
+				snapshot.time = std::chrono::duration<double>(nextStep - startTime).count();
+				snapshots.publish();
+
+				nextStep += step;
+			}
+			std::this_thread::sleep_until(nextStep);
+		}
+	}
+
+	void simulate()
+	{
+		glm::vec3 input;
+		{
+			std::lock_guard<std::mutex> lock(inputMutex);
+			input = pendingVelocity;
+			pendingVelocity = glm::vec3(0.0f);
+		}
+
+		step(*entity, input, gravity);
+	}
+};
+#endif
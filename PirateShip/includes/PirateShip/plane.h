@@ -2,7 +2,6 @@
 #ifndef PLANE_H
 #define PLANE_H
 
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -0,0 +1,203 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <PirateShip/geometry_batch.h>
+#include <PirateShip/instance_buffer.h>
+#include <PirateShip/material.h>
+#include <PirateShip/mesh.h>
+#include <PirateShip/shader_m.h>
+
+// Draws collected over a pass and submitted together, sorted by program, material and vertex array so each is bound
+// once per run instead of once per draw. Models add their meshes with Model::queue. The model matrix is set through the
+// "model" uniform and the "instanced" uniform tells instanced draws apart, as with Model::Draw.
+class RenderQueue
+{
+public:
+	// Counted by the last flush
+	unsigned int drawCalls = 0;
+	unsigned int programChanges = 0;
+	unsigned int materialChanges = 0;
+	unsigned int vertexArrayChanges = 0;
+	unsigned int transformChanges = 0;
+
+	// Index of a model matrix for the draws that follow
+	unsigned int addTransform(const glm::mat4& transform)
+	{
+		transforms.push_back(transform);
+		return (unsigned int)transforms.size() - 1;
+	}
+
+	// The mesh at its selected level of detail, drawn at a transform, or every instance in instances if not null.
+	// The level is recorded now, the mesh may select another for a later draw before the flush.
+	void add(Shader& shader, const Mesh& mesh, unsigned int transform, const InstanceBuffer* instances = nullptr)
+	{
+		Item item = makeItem(shader, *mesh.material, mesh.VAO, transform, instances);
+		item.level = MeshLevel{ mesh.levelFirstIndex(mesh.lod), mesh.levelIndexCount(mesh.lod) };
+		items.push_back(item);
+	}
+
+	// One material's group of a model's geometry batch, with the levels its meshes selected recorded as for a mesh.
+	// Instances draw every mesh, the culler only hides meshes of a single draw.
+	void add(Shader& shader, GeometryBatch& batch, const std::vector<Mesh>& meshes, size_t group, unsigned int transform,
+		const InstanceBuffer* instances = nullptr)
+	{
+		Item item = makeItem(shader, batch.groupMaterial(group), batch.vertexArray(), transform, instances);
+		item.batch = &batch;
+		item.group = group;
+		item.firstLevel = levels.size();
+		size_t first = batch.groupFirstMesh(group);
+		for (size_t i = first; i < first + batch.groupMeshCount(group) && i < meshes.size(); i++) {
+			const Mesh& mesh = meshes[i];
+			GLuint count = !instances && !mesh.visible ? 0 : mesh.levelIndexCount(mesh.lod);
+			levels.push_back(MeshLevel{ mesh.levelFirstIndex(mesh.lod), count });
+		}
+		items.push_back(item);
+	}
+
+	// Sort and draw everything added since the last flush
+	void flush()
+	{
+		drawCalls = 0;
+		programChanges = 0;
+		materialChanges = 0;
+		vertexArrayChanges = 0;
+		transformChanges = 0;
+
+		std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.key < b.key; });
+
+		Shader* shader = nullptr;
+		const Material* material = nullptr;
+		unsigned int vertexArray = 0;
+		bool vertexArrayBound = false;
+		unsigned int transform = 0;
+		bool transformSet = false;
+		bool instanced = false;
+		Uniform<glm::mat4> modelUniform;
+		Uniform<bool> instancedUniform;
+		for (const Item& item : items) {
+			if (item.shader != shader) {
+				if (shader && instanced)
+					instancedUniform.set(false);
+				shader = item.shader;
+				shader->use();
+				const ProgramUniforms& uniforms = programUniforms(*shader);
+				modelUniform = uniforms.model;
+				instancedUniform = uniforms.instanced;
+				instancedUniform.set(false);
+				instanced = false;
+				material = nullptr;
+				transformSet = false;
+				programChanges++;
+			}
+			if (item.material != material) {
+				material = item.material;
+				material->bind(*shader);
+				materialChanges++;
+			}
+			if (!vertexArrayBound || item.vertexArray != vertexArray) {
+				vertexArray = item.vertexArray;
+				vertexArrayBound = true;
+				glBindVertexArray(vertexArray);
+				vertexArrayChanges++;
+			}
+			if ((item.instances != nullptr) != instanced) {
+				instanced = item.instances != nullptr;
+				instancedUniform.set(instanced);
+			}
+			if (!instanced && (!transformSet || item.transform != transform)) {
+				transform = item.transform;
+				transformSet = true;
+				modelUniform.set(transforms[transform]);
+				transformChanges++;
+			}
+
+			if (instanced)
+				item.instances->bind();
+			if (!item.batch) {
+				void* offset = (void*)(item.level.firstIndex * sizeof(unsigned int));
+				if (instanced)
+					glDrawElementsInstanced(GL_TRIANGLES, item.level.count, GL_UNSIGNED_INT, offset, (GLsizei)item.instances->size());
+				else
+					glDrawElements(GL_TRIANGLES, item.level.count, GL_UNSIGNED_INT, offset);
+			}
+			else {
+				item.batch->setGroupLevels(item.group, &levels[item.firstLevel]);
+				item.batch->drawGroup(item.group, instanced ? (GLuint)item.instances->size() : 1);
+			}
+			if (instanced)
+				item.instances->unbind();
+			drawCalls++;
+		}
+
+		if (shader && instanced)
+			instancedUniform.set(false);
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+		items.clear();
+		transforms.clear();
+		levels.clear();
+	}
+
+private:
+	struct Item {
+		uint64_t key;
+		Shader* shader;
+		const Material* material;
+		unsigned int vertexArray;
+		unsigned int transform;
+		const InstanceBuffer* instances;	// null for a single draw
+		// what to draw, the level a mesh had selected, or a group of a batch's meshes at theirs, from firstLevel in levels
+		MeshLevel level;
+		GeometryBatch* batch;	// null for a mesh
+		size_t group;
+		size_t firstLevel;
+	};
+
+	// 8 bits of program, 24 of material, 20 of vertex array and 12 of transform, most significant first. Names that
+	// overflow their field only sort less well, flush() compares the full values.
+	Item makeItem(Shader& shader, const Material& material, unsigned int vertexArray, unsigned int transform, const InstanceBuffer* instances)
+	{
+		Item item = {};
+		item.shader = &shader;
+		item.material = &material;
+		item.vertexArray = vertexArray;
+		item.transform = transform;
+		item.instances = instances;
+		uint64_t order = instances ? 0xFFF : (transform & 0xFFF);
+		item.key = ((uint64_t)(shader.ID & 0xFF) << 56) | ((uint64_t)(material.id & 0xFFFFFF) << 32) |
+			((uint64_t)(vertexArray & 0xFFFFF) << 12) | order;
+		return item;
+	}
+
+	// The uniforms flush() sets, found once per program
+	struct ProgramUniforms {
+		GLuint program;
+		Uniform<glm::mat4> model;
+		Uniform<bool> instanced;
+	};
+
+	const ProgramUniforms& programUniforms(const Shader& shader)
+	{
+		for (const ProgramUniforms& uniforms : programs) {
+			if (uniforms.program == shader.ID)
+				return uniforms;
+		}
+		programs.push_back(ProgramUniforms{ shader.ID, shader.uniform<glm::mat4>("model"), shader.uniform<bool>("instanced") });
+		return programs.back();
+	}
+
+	std::vector<Item> items;
+	std::vector<glm::mat4> transforms;
+	std::vector<MeshLevel> levels;
+	std::vector<ProgramUniforms> programs;
+};
+#endif
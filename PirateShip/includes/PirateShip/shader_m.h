@@ -8,6 +8,23 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// uniform lookups made this frame, by name and of those by asking the driver. Uniform handles make neither.
+struct UniformStats {
+    unsigned int lookups = 0;
+    unsigned int driverLookups = 0;
+
+    static UniformStats& frame()
+    {
+        static UniformStats stats;
+        return stats;
+    }
+};
+
+template<class T>
+class Uniform;
 
 class Shader
 {
@@ -94,7 +111,7 @@ public:
         glDeleteShader(fragment);
         if (geometryPath != nullptr)
             glDeleteShader(geometry);
-
+        findUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -102,66 +119,136 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of a uniform, -1 if the program has no such active uniform
+    // ------------------------------------------------------------------------
+    GLint location(const std::string& name) const
+    {
+        UniformStats::frame().lookups++;
+        std::unordered_map<std::string, GLint>::const_iterator found = uniforms.find(name);
+        if (found != uniforms.end())
+            return found->second;
+        // not among the active uniforms, optimised out or misspelled. asked of the driver once, then remembered
+        UniformStats::frame().driverLookups++;
+        GLint resolved = glGetUniformLocation(ID, name.c_str());
+        uniforms[name] = resolved;
+        return resolved;
+    }
+    // a handle to a uniform, resolved once here so setting it every frame needs no lookup
+    // ------------------------------------------------------------------------
+    template<class T>
+    Uniform<T> uniform(const std::string& name) const
+    {
+        return Uniform<T>(location(name));
+    }
+    // set a uniform of the program in use by its location
+    // ------------------------------------------------------------------------
+    static void setUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+    static void setUniform(GLint location, int value) { glUniform1i(location, value); }
+    static void setUniform(GLint location, float value) { glUniform1f(location, value); }
+    static void setUniform(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+    static void setUniform(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+    static void setUniform(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+    static void setUniform(GLint location, const glm::mat2& mat) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); }
+    static void setUniform(GLint location, const glm::mat3& mat) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+    static void setUniform(GLint location, const glm::mat4& mat) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setUniform(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setUniform(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setUniform(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setUniform(location(name), value);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setUniform(location(name), value);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setUniform(location(name), value);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(location(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(location(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(location(name), mat);
     }
 
 private:
+    // locations of the program's uniforms by name, hashed
+    mutable std::unordered_map<std::string, GLint> uniforms;
+
+    // look up every active uniform once after linking, so setting one by name never asks the driver.
+    // arrays are listed by their first element, name[0]; the other elements and the bare name are added too.
+    // ------------------------------------------------------------------------
+    void findUniforms()
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            std::string uniform(name.data(), length);
+            GLint resolved = glGetUniformLocation(ID, uniform.c_str());
+            // members of uniform blocks have no location of their own
+            if (resolved == -1)
+                continue;
+            uniforms[uniform] = resolved;
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            {
+                std::string array = uniform.substr(0, uniform.size() - 3);
+                uniforms[array] = resolved;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = array + "[" + std::to_string(element) + "]";
+                    uniforms[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -188,4 +275,22 @@ private:
         }
     }
 };
+
+// A uniform of a shader with its location already found. Keep one and set it every frame without a lookup.
+// A uniform the shader doesn't have gets location -1, which GL ignores when set.
+template<class T>
+class Uniform
+{
+public:
+    GLint location;
+
+    Uniform() : location(-1) {}
+    explicit Uniform(GLint location) : location(location) {}
+
+    // set the uniform of the program in use
+    void set(const T& value) const
+    {
+        Shader::setUniform(location, value);
+    }
+};
 #endif
@@ -0,0 +1,359 @@
+#pragma once
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <PirateShip/collision_package.h>
+#include <PirateShip/collision_world.h>
+#include <PirateShip/math.h>
+#include <PirateShip/triangle_soa.h>
+
+// MSVC always accepts AVX2 intrinsics, other compilers only when building with -mavx2
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define PIRATESHIP_AVX2
+#endif
+
+// Instruction sets the batched collision kernel can run on
+enum SimdIsa {
+	SIMD_SCALAR,
+	SIMD_SSE,
+	SIMD_AVX2
+};
+
+// 4 float lanes, SSE2
+struct Float4 {
+	static const unsigned int width = 4;
+	__m128 v;
+
+	Float4() {}
+	Float4(__m128 v) : v(v) {}
+	Float4(float s) : v(_mm_set1_ps(s)) {}
+
+	static Float4 load(const float* data) { return _mm_loadu_ps(data); }
+	static Float4 gather(const float* data, const unsigned int* indices)
+	{
+		return _mm_setr_ps(data[indices[0]], data[indices[1]], data[indices[2]], data[indices[3]]);
+	}
+	// All bits set in the first count lanes
+	static Float4 firstLanes(unsigned int count)
+	{
+		return _mm_cmplt_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps((float)count));
+	}
+	// All bits set in lanes whose sign bit is set
+	static Float4 signMask(Float4 a) { return _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(a.v), 31)); }
+	static Float4 select(Float4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+	// ~a & b
+	static Float4 andNot(Float4 a, Float4 b) { return _mm_andnot_ps(a.v, b.v); }
+	static Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+	static Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+	static Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+	static Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+	int mask() const { return _mm_movemask_ps(v); }
+	void store(float* out) const { _mm_storeu_ps(out, v); }
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+inline Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+inline Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+inline Float4 operator==(Float4 a, Float4 b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline Float4 operator!=(Float4 a, Float4 b) { return _mm_cmpneq_ps(a.v, b.v); }
+
+#ifdef PIRATESHIP_AVX2
+// 8 float lanes, AVX2
+struct Float8 {
+	static const unsigned int width = 8;
+	__m256 v;
+
+	Float8() {}
+	Float8(__m256 v) : v(v) {}
+	Float8(float s) : v(_mm256_set1_ps(s)) {}
+
+	static Float8 load(const float* data) { return _mm256_loadu_ps(data); }
+	static Float8 gather(const float* data, const unsigned int* indices)
+	{
+		return _mm256_i32gather_ps(data, _mm256_loadu_si256((const __m256i*)indices), 4);
+	}
+	static Float8 firstLanes(unsigned int count)
+	{
+		return _mm256_cmp_ps(_mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f), _mm256_set1_ps((float)count), _CMP_LT_OQ);
+	}
+	static Float8 signMask(Float8 a) { return _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_castps_si256(a.v), 31)); }
+	static Float8 select(Float8 mask, Float8 a, Float8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+	static Float8 andNot(Float8 a, Float8 b) { return _mm256_andnot_ps(a.v, b.v); }
+	static Float8 sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+	static Float8 min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+	static Float8 max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+	static Float8 abs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+
+	int mask() const { return _mm256_movemask_ps(v); }
+	void store(float* out) const { _mm256_storeu_ps(out, v); }
+};
+
+inline Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 operator&(Float8 a, Float8 b) { return _mm256_and_ps(a.v, b.v); }
+inline Float8 operator|(Float8 a, Float8 b) { return _mm256_or_ps(a.v, b.v); }
+inline Float8 operator<(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline Float8 operator<=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline Float8 operator>(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline Float8 operator>=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline Float8 operator==(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline Float8 operator!=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+#endif
+
+// Swept sphere against many triangles at once.
+// Mirrors Math::checkTriangle lane by lane, which stays the reference implementation.
+class SimdMath
+{
+public:
+	// Widest instruction set supported by both the build and the CPU
+	static SimdIsa bestIsa()
+	{
+		static const SimdIsa isa = detectIsa();
+		return isa;
+	}
+
+	// Test the listed world triangles and keep the nearest hit in colPackage
+	static void checkTriangles(std::unique_ptr<CollisionPackage>& colPackage, const CollisionWorld& world,
+		const unsigned int* indices, unsigned int count, SimdIsa isa = bestIsa())
+	{
+		switch (isa) {
+#ifdef PIRATESHIP_AVX2
+		case SIMD_AVX2:
+			checkBatches<Float8>(colPackage, world.soa, indices, count);
+			break;
+#endif
+		case SIMD_SSE:
+			checkBatches<Float4>(colPackage, world.soa, indices, count);
+			break;
+		default:
+			for (unsigned int i = 0; i < count; i++)
+				Math::checkTriangle(colPackage, world.triangles[indices[i]]);
+			break;
+		}
+	}
+
+private:
+	static SimdIsa detectIsa()
+	{
+#ifdef PIRATESHIP_AVX2
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+		bool cpuHasAVX = (info[2] & (1 << 28)) != 0;
+		bool cpuHasFMA = (info[2] & (1 << 12)) != 0;
+		if (osUsesXSave && cpuHasAVX && cpuHasFMA && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return SIMD_AVX2;
+		}
+#else
+		if (__builtin_cpu_supports("avx2"))
+			return SIMD_AVX2;
+#endif
+#endif
+		// SSE2 is part of x64
+		return SIMD_SSE;
+	}
+
+	template<class F>
+	static void checkBatches(std::unique_ptr<CollisionPackage>& colPackage, const TriangleSoA& triangles,
+		const unsigned int* indices, unsigned int count)
+	{
+		float t[F::width];
+		float point[3][F::width];
+		unsigned int padded[F::width];
+
+		for (unsigned int first = 0; first < count; first += F::width) {
+			unsigned int lanes = count - first < F::width ? count - first : F::width;
+			const unsigned int* batch = indices + first;
+
+			// Pad the last batch with copies of its first triangle, the extra lanes are masked off
+			if (lanes < F::width) {
+				for (unsigned int i = 0; i < F::width; i++)
+					padded[i] = batch[i < lanes ? i : 0];
+				batch = padded;
+			}
+
+			int hits = checkBatch<F>(*colPackage, triangles, batch, lanes, t, point);
+
+			// Record hits in triangle order, so ties resolve like the scalar loop
+			for (unsigned int i = 0; hits != 0; i++, hits >>= 1) {
+				if (hits & 1)
+					Math::recordCollision(colPackage, t[i], glm::vec3(point[0][i], point[1][i], point[2][i]));
+			}
+		}
+	}
+
+	// Returns a bit per lane that hit, with the time and point of each hit
+	template<class F>
+	static int checkBatch(const CollisionPackage& colPackage, const TriangleSoA& triangles,
+		const unsigned int* indices, unsigned int lanes, float* tOut, float (*pointOut)[F::width])
+	{
+		F p[3][3];
+		for (int vertex = 0; vertex < 3; vertex++) {
+			for (int axis = 0; axis < 3; axis++)
+				p[vertex][axis] = F::gather(triangles.component(vertex, axis), indices);
+		}
+
+		F base[3] = { colPackage.basePoint.x, colPackage.basePoint.y, colPackage.basePoint.z };
+		F vel[3] = { colPackage.velocity.x, colPackage.velocity.y, colPackage.velocity.z };
+		F one(1.0f), zero(0.0f);
+
+		// Precomputed plane containing each triangle
+		F n[3];
+		for (int axis = 0; axis < 3; axis++)
+			n[axis] = F::gather(triangles.normal(axis), indices);
+		F planeConstant = F::gather(triangles.planeConstant(), indices);
+
+		// Only front-facing triangles
+		F normalizedVelocity[3] = { colPackage.normalizedVelocity.x, colPackage.normalizedVelocity.y, colPackage.normalizedVelocity.z };
+		F active = F::firstLanes(lanes) & (dot(n, normalizedVelocity) <= zero);
+		if (active.mask() == 0)
+			return 0;
+
+		// Interval of plane intersection
+		F signedDistance = dot(base, n) + planeConstant;
+		F normalDotVelocity = dot(n, vel);
+		F parallel = normalDotVelocity == zero;
+		F embedded = parallel & (F::abs(signedDistance) < one);
+		F ta = (F(-1.0f) - signedDistance) / normalDotVelocity;
+		F tb = (one - signedDistance) / normalDotVelocity;
+		F t0 = F::min(ta, tb);
+		F t1 = F::max(ta, tb);
+		F inRange = (normalDotVelocity != zero) & (t0 <= one) & (t1 >= zero);
+		active = active & (embedded | inRange);
+		if (active.mask() == 0)
+			return 0;
+		t0 = F::select(embedded, zero, F::min(F::max(t0, zero), one));
+
+		// Collision inside the triangle at t0
+		F e1[3], e2[3];
+		for (int axis = 0; axis < 3; axis++) {
+			e1[axis] = p[1][axis] - p[0][axis];
+			e2[axis] = p[2][axis] - p[0][axis];
+		}
+		F planePoint[3];
+		for (int axis = 0; axis < 3; axis++)
+			planePoint[axis] = (base[axis] - n[axis]) + t0 * vel[axis];
+		F hit = F::andNot(embedded, active) & pointInTriangle(planePoint, p[0], e1, e2);
+		F t = F::select(hit, t0, one);
+		F point[3];
+		for (int axis = 0; axis < 3; axis++)
+			point[axis] = F::select(hit, planePoint[axis], zero);
+
+		// Otherwise sweep against the vertices and edges
+		F sweep = F::andNot(hit, active);
+		if (sweep.mask() != 0) {
+			F velocitySquaredLength = dot(vel, vel);
+
+			for (int vertex = 0; vertex < 3; vertex++) {
+				F baseToVertex[3];
+				for (int axis = 0; axis < 3; axis++)
+					baseToVertex[axis] = base[axis] - p[vertex][axis];
+				F b = F(2.0f) * dot(vel, baseToVertex);
+				F c = dot(baseToVertex, baseToVertex) - one;
+
+				F root;
+				F found = sweep & lowestRoot(velocitySquaredLength, b, c, t, root);
+				t = F::select(found, root, t);
+				for (int axis = 0; axis < 3; axis++)
+					point[axis] = F::select(found, p[vertex][axis], point[axis]);
+				hit = hit | found;
+			}
+
+			for (int vertex = 0; vertex < 3; vertex++) {
+				const F* start = p[vertex];
+				// Edges and their lengths were cached with the triangles
+				F edge[3], baseToVertex[3];
+				for (int axis = 0; axis < 3; axis++) {
+					edge[axis] = F::gather(triangles.edgeComponent(vertex, axis), indices);
+					baseToVertex[axis] = start[axis] - base[axis];
+				}
+				F edgeSquaredLength = F::gather(triangles.edgeSquaredLength(vertex), indices);
+				F edgeDotVelocity = dot(edge, vel);
+				F edgeDotBaseToVertex = dot(edge, baseToVertex);
+
+				F a = edgeSquaredLength * (zero - velocitySquaredLength) + edgeDotVelocity * edgeDotVelocity;
+				F b = edgeSquaredLength * (F(2.0f) * dot(vel, baseToVertex)) - F(2.0f) * edgeDotVelocity * edgeDotBaseToVertex;
+				F c = edgeSquaredLength * (one - dot(baseToVertex, baseToVertex)) + edgeDotBaseToVertex * edgeDotBaseToVertex;
+
+				F root;
+				F found = sweep & lowestRoot(a, b, c, t, root);
+				// Intersection must be within the line segment
+				F f = (edgeDotVelocity * root - edgeDotBaseToVertex) / edgeSquaredLength;
+				found = found & (f >= zero) & (f <= one);
+				t = F::select(found, root, t);
+				for (int axis = 0; axis < 3; axis++)
+					point[axis] = F::select(found, start[axis] + f * edge[axis], point[axis]);
+				hit = hit | found;
+			}
+		}
+
+		t.store(tOut);
+		for (int axis = 0; axis < 3; axis++)
+			point[axis].store(pointOut[axis]);
+		return hit.mask();
+	}
+
+	template<class F>
+	static F dot(const F* a, const F* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Same sign trick as Math::checkPointInTriangle, with e1 = pb - pa and e2 = pc - pa
+	template<class F>
+	static F pointInTriangle(const F* point, const F* pa, const F* e1, const F* e2)
+	{
+		F a = dot(e1, e1);
+		F b = dot(e1, e2);
+		F c = dot(e2, e2);
+		F acbb = a * c - b * b;
+		F vp[3] = { point[0] - pa[0], point[1] - pa[1], point[2] - pa[2] };
+		F d = dot(vp, e1);
+		F e = dot(vp, e2);
+		F x = d * c - e * b;
+		F y = e * a - d * b;
+		F z = x + y - acbb;
+		return F::signMask(F::andNot(x | y, z));
+	}
+
+	// Lowest root of a*t^2 + b*t + c in (0, maxR), per lane
+	template<class F>
+	static F lowestRoot(F a, F b, F c, F maxR, F& root)
+	{
+		F zero(0.0f);
+		F determinant = b * b - F(4.0f) * a * c;
+		F sqrtD = F::sqrt(F::max(determinant, zero));
+		F twoA = F(2.0f) * a;
+		F r1 = (zero - b - sqrtD) / twoA;
+		F r2 = (zero - b + sqrtD) / twoA;
+		F low = F::min(r1, r2);
+		F high = F::max(r1, r2);
+		F lowValid = (low > zero) & (low < maxR);
+		F highValid = (high > zero) & (high < maxR);
+		root = F::select(lowValid, low, high);
+		return (determinant >= zero) & (lowValid | highValid);
+	}
+};
+#endif
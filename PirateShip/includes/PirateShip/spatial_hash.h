@@ -0,0 +1,138 @@
+#pragma once
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include <PirateShip/aabb.h>
+#include <PirateShip/triangle_buffer.h>
+
+// Uniform grid over a triangle soup, hashed so only occupied cells cost memory.
+// An alternative broad-phase to the BVH for large, flat worlds made of many small triangles.
+class SpatialHash
+{
+public:
+	// Edge length of a cell in ellipsoid space, a few unit spheres works well for walking speeds
+	float cellSize = 2.0f;
+
+	void build(const TriangleBuffer& triangles)
+	{
+		triangleBounds.resize(triangles.size());
+		for (unsigned int i = 0; i < triangles.size(); i++) {
+			AABB box;
+			box.expand(triangles[i].p1);
+			box.expand(triangles[i].p2);
+			box.expand(triangles[i].p3);
+			triangleBounds[i] = box;
+		}
+
+		// Around two buckets per triangle keeps collisions between cells rare
+		unsigned int bucketCount = 1;
+		while (bucketCount < 2 * triangles.size())
+			bucketCount <<= 1;
+		bucketMask = bucketCount - 1;
+
+		// Count, prefix sum, then fill, so every bucket is a contiguous range of bucketTriangles
+		bucketStart.assign(bucketCount + 1, 0);
+		lastTriangle.assign(bucketCount, ~0u);
+		forEachCell(true);
+		for (unsigned int b = 0; b < bucketCount; b++)
+			bucketStart[b + 1] += bucketStart[b];
+
+		bucketTriangles.resize(bucketStart[bucketCount]);
+		fill.assign(bucketStart.begin(), bucketStart.end() - 1);
+		lastTriangle.assign(bucketCount, ~0u);
+		forEachCell(false);
+	}
+
+	bool empty() const { return triangleBounds.empty(); }
+
+	// Append the indices of every triangle whose bounds overlap box, each one exactly once
+	void query(const AABB& box, std::vector<unsigned int>& out) const
+	{
+		if (empty())
+			return;
+
+		glm::ivec3 first = cell(box.min);
+		glm::ivec3 last = cell(box.max);
+		glm::vec3 span = glm::vec3(last - first) + 1.0f;
+
+		// A huge sweep would walk more cells than there are triangles
+		if (span.x * span.y * span.z > (float)triangleBounds.size()) {
+			for (unsigned int i = 0; i < triangleBounds.size(); i++) {
+				if (triangleBounds[i].overlaps(box))
+					out.push_back(i);
+			}
+			return;
+		}
+
+		for (int x = first.x; x <= last.x; x++) {
+			for (int y = first.y; y <= last.y; y++) {
+				for (int z = first.z; z <= last.z; z++) {
+					glm::ivec3 current(x, y, z);
+					unsigned int b = bucket(current);
+					for (unsigned int i = bucketStart[b]; i < bucketStart[b + 1]; i++) {
+						unsigned int t = bucketTriangles[i];
+						const AABB& bounds = triangleBounds[t];
+						if (!bounds.overlaps(box))
+							continue;
+						// A triangle spanning several cells is only reported from the cell holding
+						// the minimum corner of its overlap with the box, which also skips hash collisions
+						if (cell(glm::max(bounds.min, box.min)) == current)
+							out.push_back(t);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<AABB> triangleBounds;
+	// bucketTriangles[bucketStart[b] .. bucketStart[b + 1]) are the triangles in bucket b
+	std::vector<unsigned int> bucketStart;
+	std::vector<unsigned int> bucketTriangles;
+	unsigned int bucketMask = 0;
+	// Build scratch
+	std::vector<unsigned int> fill;
+	std::vector<unsigned int> lastTriangle;
+
+	// Visit every cell each triangle's bounds cover, counting or storing it in its bucket
+	void forEachCell(bool counting)
+	{
+		for (unsigned int t = 0; t < triangleBounds.size(); t++) {
+			glm::ivec3 first = cell(triangleBounds[t].min);
+			glm::ivec3 last = cell(triangleBounds[t].max);
+			for (int x = first.x; x <= last.x; x++) {
+				for (int y = first.y; y <= last.y; y++) {
+					for (int z = first.z; z <= last.z; z++) {
+						unsigned int b = bucket(glm::ivec3(x, y, z));
+						// Cells of the same triangle can share a bucket, store it there once
+						if (lastTriangle[b] == t)
+							continue;
+						lastTriangle[b] = t;
+						if (counting)
+							bucketStart[b + 1]++;
+						else
+							bucketTriangles[fill[b]++] = t;
+					}
+				}
+			}
+		}
+	}
+
+	glm::ivec3 cell(const glm::vec3& point) const
+	{
+		// Clamped so far away points can't overflow the integer coordinates
+		glm::vec3 scaled = glm::clamp(point / cellSize, glm::vec3(-1e6f), glm::vec3(1e6f));
+		return glm::ivec3((int)std::floor(scaled.x), (int)std::floor(scaled.y), (int)std::floor(scaled.z));
+	}
+
+	unsigned int bucket(const glm::ivec3& c) const
+	{
+		return ((unsigned int)c.x * 73856093u ^ (unsigned int)c.y * 19349663u ^ (unsigned int)c.z * 83492791u) & bucketMask;
+	}
+};
+#endif
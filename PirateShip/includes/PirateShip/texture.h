@@ -5,48 +5,224 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include <stb/stb_image.h>
 
-unsigned int loadTexture(char const* path);
+// S3TC is an extension, which a glad generated without it doesn't define
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Pixels decoded by stb_image. Decoding touches no GL state, so it can run on any thread.
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	unsigned char* pixels = nullptr;
+
+	DecodedImage() {}
+	~DecodedImage() { stbi_image_free(pixels); }
+
+	DecodedImage(const DecodedImage&) = delete;
+	DecodedImage& operator=(const DecodedImage&) = delete;
 
-// Utility function for loading a 2D texture from file
-unsigned int loadTexture(char const* path)
+	DecodedImage(DecodedImage&& other) { *this = std::move(other); }
+	DecodedImage& operator=(DecodedImage&& other)
+	{
+		if (this != &other)
+		{
+			stbi_image_free(pixels);
+			width = other.width;
+			height = other.height;
+			components = other.components;
+			pixels = other.pixels;
+			other.pixels = nullptr;
+		}
+		return *this;
+	}
+};
+
+// How a texture is stored on the GPU
+enum TextureFormat {
+	FORMAT_RGBA8,	// uncompressed, 4 bytes a pixel
+	FORMAT_BC1,		// RGB, 8 bytes a 4x4 block
+	FORMAT_BC3,		// RGBA, 16 bytes a block
+	FORMAT_BC4,		// one channel, 8 bytes a block
+	FORMAT_BC5		// two channels, 16 bytes a block
+};
+
+// A texture ready to upload: every mip level, largest first, already in its GPU format.
+// Encoding touches no GL state either, so it can also run on any thread.
+struct EncodedImage
+{
+	TextureFormat format = FORMAT_RGBA8;
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<unsigned char>> levels;
+
+	size_t bytes() const
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < levels.size(); i++)
+			total += levels[i].size();
+		return total;
+	}
+};
+
+DecodedImage decodeImage(char const* path, bool flipVertically = true);
+bool textureCompressionSupported();
+void uploadTextureLevel(const EncodedImage& image, size_t level, const void* pixels);
+unsigned int uploadTexture(const EncodedImage& image, unsigned int pixelBuffer = 0, size_t firstLevel = 0);
+void streamTextureLevel(unsigned int texture, const EncodedImage& image, size_t level);
+void evictTextureLevel(unsigned int texture, size_t level);
+
+// Read and decode an image file, pixels stays null if it can't be. Flipped, the first row is the bottom one,
+// as GL expects. The flip is done here rather than with stb_image's global flag so every load chooses its own.
+DecodedImage decodeImage(char const* path, bool flipVertically)
+{
+	DecodedImage image;
+	image.pixels = stbi_load(path, &image.width, &image.height, &image.components, 0);
+	if (image.pixels && flipVertically)
+	{
+		size_t stride = (size_t)image.width * image.components;
+		std::vector<unsigned char> row(stride);
+		for (int y = 0; y < image.height / 2; y++)
+		{
+			unsigned char* top = image.pixels + y * stride;
+			unsigned char* bottom = image.pixels + (image.height - 1 - y) * stride;
+			memcpy(row.data(), top, stride);
+			memcpy(top, bottom, stride);
+			memcpy(bottom, row.data(), stride);
+		}
+	}
+	return image;
+}
+
+// True if the context takes the S3TC formats, BC1 and BC3. BC4 and BC5 (RGTC) are core since GL 3.0.
+bool textureCompressionSupported()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		supported = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+				supported = 1;
+		}
+	}
+	return supported != 0;
+}
+
+// Specify one level of the bound texture from pixels, a pointer or an offset into the bound pixel unpack buffer
+void uploadTextureLevel(const EncodedImage& image, size_t level, const void* pixels)
+{
+	int width = std::max(image.width >> level, 1);
+	int height = std::max(image.height >> level, 1);
+	GLsizei size = (GLsizei)image.levels[level].size();
+
+	if (image.format == FORMAT_RGBA8)
+		glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	else if (image.format == FORMAT_BC1)
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, width, height, 0, size, pixels);
+	else if (image.format == FORMAT_BC3)
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, width, height, 0, size, pixels);
+	else if (image.format == FORMAT_BC4)
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_COMPRESSED_RED_RGTC1, width, height, 0, size, pixels);
+	else
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_COMPRESSED_RG_RGTC2, width, height, 0, size, pixels);
+}
+
+// Upload the levels of an encoded image from firstLevel down to 1x1 as a repeating texture. Levels keep their numbers, so
+// finer ones can be streamed in later. A texture name is returned even if there are no levels. With a pixel buffer the
+// levels are copied into it and GL reads them from there, so the upload doesn't wait on the copy.
+unsigned int uploadTexture(const EncodedImage& image, unsigned int pixelBuffer, size_t firstLevel)
 {
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
+	if (firstLevel < image.levels.size())
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
+		glBindTexture(GL_TEXTURE_2D, textureID);
 
+		size_t bytes = 0;
+		for (size_t i = firstLevel; i < image.levels.size(); i++)
+			bytes += image.levels[i].size();
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		bool staged = false;
+		if (pixelBuffer != 0)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+			// Orphan the last upload's storage instead of waiting for GL to finish reading it
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+			unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (mapped)
+			{
+				for (size_t i = firstLevel; i < image.levels.size(); i++)
+				{
+					memcpy(mapped, image.levels[i].data(), image.levels[i].size());
+					mapped += image.levels[i].size();
+				}
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				staged = true;
+			}
+			else
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		size_t offset = 0;
+		for (size_t i = firstLevel; i < image.levels.size(); i++)
+		{
+			// Staged, the pointer is an offset into the pixel buffer
+			uploadTextureLevel(image, i, staged ? (const void*)offset : (const void*)image.levels[i].data());
+			offset += image.levels[i].size();
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)firstLevel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+
+		// One channel reads back in every colour channel, as the grey image it was encoded from
+		if (image.format == FORMAT_BC4)
+		{
+			GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
 	}
 
 	return textureID;
 }
+
+// Give a texture uploaded from level + 1 its next finer level, and sample from it
+void streamTextureLevel(unsigned int texture, const EncodedImage& image, size_t level)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	uploadTextureLevel(image, level, image.levels[level].data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level);
+}
+
+// Free a texture's finest level, sampling carries on from the next one. Levels below the base level don't count
+// towards completeness, so the empty level is never read.
+void evictTextureLevel(unsigned int texture, size_t level)
+{
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level + 1);
+	glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+}
 #endif
@@ -0,0 +1,180 @@
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <PirateShip/compressed_texture_cache.h>
+#include <PirateShip/texture.h>
+#include <PirateShip/texture_compressor.h>
+
+// A GL texture shared by everything that asked the cache for the same image. id is 0, which binds no
+// texture, until the pixels have been uploaded. The texture is deleted when the last handle goes.
+struct CachedTexture {
+	unsigned int id = 0;
+	bool loaded = false;
+	int width = 0;				// of the image, 0 if it failed to load
+	int height = 0;
+	size_t bytes = 0;			// on the GPU, the resident levels
+	unsigned int requests = 0;	// times the cache handed it out
+
+	// What a TextureStreamer keeps of a texture it streams, see texture_streamer.h
+	EncodedImage source;				// every level, in system memory to stream the finer ones from, empty if not streamed
+	unsigned int residentLevel = 0;		// finest level on the GPU, the coarser ones down to 1x1 are there as well
+	unsigned int requestedLevel = 0;	// finest level a draw asked for since the last streaming update
+	bool requested = false;
+	unsigned int lastUsed = 0;			// streaming frame of the last draw
+
+	CachedTexture() {}
+	~CachedTexture()
+	{
+		if (id != 0)
+			glDeleteTextures(1, &id);
+	}
+
+	CachedTexture(const CachedTexture&) = delete;
+	CachedTexture& operator=(const CachedTexture&) = delete;
+};
+
+typedef std::shared_ptr<CachedTexture> TextureHandle;
+
+// Every texture the process loads, keyed by canonical path and load parameters, so the same image is
+// read, encoded and uploaded once however many models and shaders use it. GL thread only.
+class TextureCache
+{
+public:
+	static TextureCache& instance()
+	{
+		static TextureCache cache;
+		return cache;
+	}
+
+	// The texture for path, created empty if nobody holds it yet. created tells the caller it has to fill() it.
+	TextureHandle acquire(const std::string& path, TextureRole role, bool flipVertically, bool& created)
+	{
+		std::string name = key(path, role, flipVertically);
+		requests++;
+		std::unordered_map<std::string, std::weak_ptr<CachedTexture>>::iterator entry = textures.find(name);
+		if (entry != textures.end()) {
+			TextureHandle texture = entry->second.lock();
+			if (texture) {
+				created = false;
+				texture->requests++;
+				if (texture->loaded)
+					savedBytes += texture->bytes;
+				return texture;
+			}
+		}
+
+		created = true;
+		TextureHandle texture = std::make_shared<CachedTexture>();
+		texture->requests = 1;
+		textures[name] = texture;
+		return texture;
+	}
+
+	// The texture for path, read and uploaded here if nobody has done it yet
+	TextureHandle load(const std::string& path, TextureRole role = TEXTURE_COLOR, bool flipVertically = true)
+	{
+		bool created;
+		TextureHandle texture = acquire(path, role, flipVertically, created);
+		if (!texture->loaded) {
+			EncodedImage image;
+			if (!loadEncodedImage(path, role, flipVertically, textureCompressionSupported(), image))
+				std::cout << "Texture failed to load at path: " << path << std::endl;
+			fill(*texture, image);
+		}
+		return texture;
+	}
+
+	// Upload the image of a texture acquire() created, from firstLevel down. Whoever has it first fills it, later calls do nothing.
+	void fill(CachedTexture& texture, const EncodedImage& image, unsigned int pixelBuffer = 0, unsigned int firstLevel = 0)
+	{
+		if (texture.loaded)
+			return;
+		texture.id = uploadTexture(image, pixelBuffer, firstLevel);
+		texture.width = image.width;
+		texture.height = image.height;
+		texture.bytes = 0;
+		for (size_t i = firstLevel; i < image.levels.size(); i++)
+			texture.bytes += image.levels[i].size();
+		texture.residentLevel = firstLevel;
+		texture.loaded = true;
+		loadedBytes += texture.bytes;
+		uncompressedBytes += (size_t)image.width * image.height * 4 * 4 / 3;
+		// Everyone who asked while it was on its way shares it too
+		savedBytes += (texture.requests - 1) * texture.bytes;
+	}
+
+	// Textures still held by someone
+	size_t size()
+	{
+		size_t live = 0;
+		for (std::unordered_map<std::string, std::weak_ptr<CachedTexture>>::iterator entry = textures.begin(); entry != textures.end(); ) {
+			if (entry->second.expired())
+				entry = textures.erase(entry);
+			else {
+				live++;
+				++entry;
+			}
+		}
+		return live;
+	}
+
+	unsigned int requests = 0;
+	size_t loadedBytes = 0;	// uploaded at load, counting every texture once
+	size_t uncompressedBytes = 0;	// the same textures as RGBA8 with mipmaps
+	size_t savedBytes = 0;	// what the repeated requests would have uploaded again without the cache
+
+	// Backslashes, "." and "dir/.." spell the same file differently, the canonical path doesn't
+	static std::string canonicalPath(const std::string& path)
+	{
+		std::vector<std::string> parts;
+		size_t start = 0;
+		while (start <= path.size()) {
+			size_t end = path.find_first_of("/\\", start);
+			if (end == std::string::npos)
+				end = path.size();
+			std::string part = path.substr(start, end - start);
+			if (part == "..") {
+				if (!parts.empty() && parts.back() != "..")
+					parts.pop_back();
+				else
+					parts.push_back(part);
+			}
+			else if (!part.empty() && part != ".")
+				parts.push_back(part);
+			start = end + 1;
+		}
+
+		std::string canonical = !path.empty() && (path[0] == '/' || path[0] == '\\') ? "/" : "";
+		for (size_t i = 0; i < parts.size(); i++) {
+			if (i > 0)
+				canonical += '/';
+			canonical += parts[i];
+		}
+		return canonical;
+	}
+
+private:
+	TextureCache() {}
+
+	static std::string key(const std::string& path, TextureRole role, bool flipVertically)
+	{
+		return canonicalPath(path) + (flipVertically ? "|flipped|" : "|upright|") + std::to_string(role);
+	}
+
+	std::unordered_map<std::string, std::weak_ptr<CachedTexture>> textures;
+};
+
+// Utility function for loading a 2D texture from file, shared with everyone else who loads it
+TextureHandle loadTexture(char const* path, TextureRole role = TEXTURE_COLOR, bool flipVertically = true)
+{
+	return TextureCache::instance().load(path, role, flipVertically);
+}
+#endif
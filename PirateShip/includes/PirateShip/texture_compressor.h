@@ -0,0 +1,362 @@
+#pragma once
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <PirateShip/texture.h>
+
+// What a texture is for, which decides how it can be compressed
+enum TextureRole {
+	TEXTURE_COLOR,	// diffuse and other colour maps: BC1, or BC3 if they have alpha
+	TEXTURE_NORMAL,	// tangent space normals: BC5 keeps x and y, the shaders rebuild z
+	TEXTURE_MASK,	// specular and other grey maps: BC4, or BC1 if they turn out to have colour after all
+	TEXTURE_FLOW	// flow maps: BC1, the shaders read a strength from z as well as the direction from x and y
+};
+
+// Builds the mip chain of a decoded image on the CPU and block compresses every level, so loading needs
+// neither glGenerateMipmap nor the driver's own compressor, and the texture takes a quarter to an eighth of the memory.
+class TextureCompressor
+{
+public:
+	// Role of a material texture, from the type the model loader gave it
+	static TextureRole roleOf(const std::string& type)
+	{
+		if (type == "texture_normal")
+			return TEXTURE_NORMAL;
+		if (type == "texture_specular")
+			return TEXTURE_MASK;
+		return TEXTURE_COLOR;
+	}
+
+	// Every mip level of image down to 1x1, in the format its role calls for, or plain RGBA8 if compress is false.
+	// Empty if the image has no pixels.
+	static EncodedImage encode(const DecodedImage& image, TextureRole role, bool compress)
+	{
+		EncodedImage encoded;
+		if (!image.pixels || image.width <= 0 || image.height <= 0)
+			return encoded;
+
+		std::vector<unsigned char> rgba = expand(image);
+		encoded.format = compress ? chooseFormat(rgba, role) : FORMAT_RGBA8;
+		encoded.width = image.width;
+		encoded.height = image.height;
+
+		int width = image.width, height = image.height;
+		for (;;) {
+			encoded.levels.push_back(encodeLevel(rgba, width, height, encoded.format));
+			if (width == 1 && height == 1)
+				break;
+			rgba = downsample(rgba, width, height, role == TEXTURE_NORMAL);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		return encoded;
+	}
+
+	// Bytes one level takes in format
+	static size_t levelSize(TextureFormat format, int width, int height)
+	{
+		if (format == FORMAT_RGBA8)
+			return (size_t)width * height * 4;
+		size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+		return blocks * (format == FORMAT_BC1 || format == FORMAT_BC4 ? 8 : 16);
+	}
+
+private:
+	// Any image as 4 bytes a pixel, grey in every colour channel if it has one or two components
+	static std::vector<unsigned char> expand(const DecodedImage& image)
+	{
+		size_t pixels = (size_t)image.width * image.height;
+		std::vector<unsigned char> rgba(pixels * 4);
+		for (size_t i = 0; i < pixels; i++) {
+			const unsigned char* source = image.pixels + i * image.components;
+			unsigned char* target = &rgba[i * 4];
+			if (image.components <= 2) {
+				target[0] = target[1] = target[2] = source[0];
+				target[3] = image.components == 2 ? source[1] : 255;
+			}
+			else {
+				target[0] = source[0];
+				target[1] = source[1];
+				target[2] = source[2];
+				target[3] = image.components == 4 ? source[3] : 255;
+			}
+		}
+		return rgba;
+	}
+
+	static TextureFormat chooseFormat(const std::vector<unsigned char>& rgba, TextureRole role)
+	{
+		if (role == TEXTURE_NORMAL)
+			return FORMAT_BC5;
+		if (role == TEXTURE_FLOW)
+			return FORMAT_BC1;
+
+		bool alpha = false, grey = true;
+		for (size_t i = 0; i < rgba.size(); i += 4) {
+			alpha |= rgba[i + 3] != 255;
+			// JPEG leaves a little colour noise in grey images
+			grey &= std::abs(rgba[i] - rgba[i + 1]) <= 8 && std::abs(rgba[i] - rgba[i + 2]) <= 8;
+		}
+		if (role == TEXTURE_MASK && grey)
+			return FORMAT_BC4;
+		return alpha ? FORMAT_BC3 : FORMAT_BC1;
+	}
+
+	// Box filter to half size. Normals are averaged as vectors and renormalised, so they stay unit length.
+	static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, int width, int height, bool normals)
+	{
+		int halfWidth = std::max(width / 2, 1), halfHeight = std::max(height / 2, 1);
+		std::vector<unsigned char> half((size_t)halfWidth * halfHeight * 4);
+		for (int y = 0; y < halfHeight; y++) {
+			for (int x = 0; x < halfWidth; x++) {
+				int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+				const unsigned char* p[4] = {
+					&rgba[((size_t)y0 * width + x0) * 4], &rgba[((size_t)y0 * width + x1) * 4],
+					&rgba[((size_t)y1 * width + x0) * 4], &rgba[((size_t)y1 * width + x1) * 4]
+				};
+				unsigned char* target = &half[((size_t)y * halfWidth + x) * 4];
+
+				if (normals) {
+					float n[3] = { 0, 0, 0 };
+					for (int k = 0; k < 4; k++) {
+						for (int c = 0; c < 3; c++)
+							n[c] += p[k][c] / 127.5f - 1.0f;
+					}
+					float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (int c = 0; c < 3; c++)
+						target[c] = (unsigned char)std::min(std::max((length > 0 ? n[c] / length : 0.0f) * 127.5f + 127.5f + 0.5f, 0.0f), 255.0f);
+					target[3] = (unsigned char)((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) / 4);
+				}
+				else {
+					for (int c = 0; c < 4; c++)
+						target[c] = (unsigned char)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+				}
+			}
+		}
+		return half;
+	}
+
+	static std::vector<unsigned char> encodeLevel(const std::vector<unsigned char>& rgba, int width, int height, TextureFormat format)
+	{
+		if (format == FORMAT_RGBA8)
+			return rgba;
+
+		std::vector<unsigned char> encoded(levelSize(format, width, height));
+		size_t blockSize = format == FORMAT_BC1 || format == FORMAT_BC4 ? 8 : 16;
+		unsigned char* out = encoded.data();
+		unsigned char block[64];
+		for (int by = 0; by < height; by += 4) {
+			for (int bx = 0; bx < width; bx += 4) {
+				// Blocks hanging over the edge repeat the last row and column
+				for (int y = 0; y < 4; y++) {
+					for (int x = 0; x < 4; x++) {
+						size_t source = ((size_t)std::min(by + y, height - 1) * width + std::min(bx + x, width - 1)) * 4;
+						memcpy(&block[(y * 4 + x) * 4], &rgba[source], 4);
+					}
+				}
+
+				if (format == FORMAT_BC1)
+					encodeColorBlock(block, out);
+				else if (format == FORMAT_BC3) {
+					encodeChannelBlock(block, 3, out);
+					encodeColorBlock(block, out + 8);
+				}
+				else if (format == FORMAT_BC4)
+					encodeChannelBlock(block, 0, out);
+				else {
+					encodeChannelBlock(block, 0, out);
+					encodeChannelBlock(block, 1, out + 8);
+				}
+				out += blockSize;
+			}
+		}
+		return encoded;
+	}
+
+	// BC4 block of one channel: two 8-bit endpoints with six values between them, a 3-bit index a pixel
+	static void encodeChannelBlock(const unsigned char* block, int channel, unsigned char* out)
+	{
+		int low = 255, high = 0;
+		for (int i = 0; i < 16; i++) {
+			low = std::min(low, (int)block[i * 4 + channel]);
+			high = std::max(high, (int)block[i * 4 + channel]);
+		}
+
+		// The first endpoint above the second selects the eight value mode
+		int palette[8] = { high, low };
+		for (int i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * high + (i - 1) * low + 3) / 7;
+
+		uint64_t indices = 0;
+		if (high != low) {
+			for (int i = 0; i < 16; i++) {
+				int value = block[i * 4 + channel];
+				int best = 0;
+				for (int k = 1; k < 8; k++) {
+					if (std::abs(palette[k] - value) < std::abs(palette[best] - value))
+						best = k;
+				}
+				indices |= (uint64_t)best << (3 * i);
+			}
+		}
+
+		out[0] = (unsigned char)high;
+		out[1] = (unsigned char)low;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	// BC1 block: two RGB565 endpoints along the block's principal colour axis with two colours between them,
+	// a 2-bit index a pixel, then the endpoints refit to those indices by least squares if that does better
+	static void encodeColorBlock(const unsigned char* block, unsigned char* out)
+	{
+		float pixels[16][3];
+		float mean[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 3; c++) {
+				pixels[i][c] = block[i * 4 + c];
+				mean[c] += pixels[i][c] / 16.0f;
+			}
+		}
+
+		float covariance[6] = { 0, 0, 0, 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			float r = pixels[i][0] - mean[0], g = pixels[i][1] - mean[1], b = pixels[i][2] - mean[2];
+			covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+			covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+		}
+
+		// Power iteration for the direction the colours spread along most
+		float axis[3] = { 1, 1, 1 };
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+			};
+			float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+			if (length == 0.0f)
+				break;
+			for (int c = 0; c < 3; c++)
+				axis[c] = next[c] / length;
+		}
+
+		float low = 0, high = 0;
+		for (int i = 0; i < 16; i++) {
+			float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+		float lengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float start[3], end[3];
+		for (int c = 0; c < 3; c++) {
+			start[c] = mean[c] + axis[c] * high / lengthSquared;
+			end[c] = mean[c] + axis[c] * low / lengthSquared;
+		}
+
+		uint16_t color0 = pack565(start), color1 = pack565(end);
+		uint32_t indices;
+		float error = colorIndices(pixels, color0, color1, indices);
+
+		// Refit: the endpoints that best reproduce the pixels with the indices just chosen
+		float a = 0, b = 0, d = 0, x[3] = { 0, 0, 0 }, y[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++) {
+			static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+			float alpha = weights[(indices >> (2 * i)) & 3], beta = 1.0f - alpha;
+			a += alpha * alpha;
+			b += alpha * beta;
+			d += beta * beta;
+			for (int c = 0; c < 3; c++) {
+				x[c] += alpha * pixels[i][c];
+				y[c] += beta * pixels[i][c];
+			}
+		}
+		float determinant = a * d - b * b;
+		if (std::fabs(determinant) > 1e-6f) {
+			for (int c = 0; c < 3; c++) {
+				start[c] = (x[c] * d - y[c] * b) / determinant;
+				end[c] = (y[c] * a - x[c] * b) / determinant;
+			}
+			uint16_t refit0 = pack565(start), refit1 = pack565(end);
+			uint32_t refitIndices;
+			float refitError = colorIndices(pixels, refit0, refit1, refitIndices);
+			if (refitError < error) {
+				color0 = refit0;
+				color1 = refit1;
+				indices = refitIndices;
+			}
+		}
+
+		// The first endpoint above the second selects the four colour mode, which BC3 assumes as well
+		if (color0 < color1) {
+			std::swap(color0, color1);
+			// 0 and 1 swap, as do 2 and 3
+			indices ^= 0x55555555u;
+		}
+		else if (color0 == color1)
+			indices = 0;
+
+		out[0] = (unsigned char)color0;
+		out[1] = (unsigned char)(color0 >> 8);
+		out[2] = (unsigned char)color1;
+		out[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	// Nearest of the four colours between color0 and color1 for every pixel, and the summed squared error
+	static float colorIndices(const float pixels[16][3], uint16_t color0, uint16_t color1, uint32_t& indices)
+	{
+		float palette[4][3];
+		unpack565(color0, palette[0]);
+		unpack565(color1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3.0f;
+		}
+
+		indices = 0;
+		float error = 0;
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			float bestDistance = 0;
+			for (int k = 0; k < 4; k++) {
+				float distance = 0;
+				for (int c = 0; c < 3; c++)
+					distance += (pixels[i][c] - palette[k][c]) * (pixels[i][c] - palette[k][c]);
+				if (k == 0 || distance < bestDistance) {
+					best = k;
+					bestDistance = distance;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+			error += bestDistance;
+		}
+		return error;
+	}
+
+	static uint16_t pack565(const float color[3])
+	{
+		int r = (int)std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+		int g = (int)std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+		int b = (int)std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	static void unpack565(uint16_t packed, float color[3])
+	{
+		int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+	}
+};
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <PirateShip/texture.h>
+#include <PirateShip/texture_cache.h>
+#include <PirateShip/texture_compressor.h>
+
+// Keeps material textures at the mip levels their draws need. A texture starts with only its small levels on the GPU,
+// draws report how fine a level they would sample, and update() streams finer levels in from the texture's encoded
+// image in system memory, evicting the least recently used levels when they would take the GPU over budget.
+// GL thread only.
+class TextureStreamer
+{
+public:
+	static TextureStreamer& instance()
+	{
+		static TextureStreamer streamer;
+		return streamer;
+	}
+
+	size_t budget = 256u << 20;				// bytes streamed textures may take on the GPU
+	unsigned int initialSize = 64;			// largest level uploaded at load, in texels along the longer side. Never evicted.
+	size_t uploadBytesPerFrame = 4u << 20;	// streamed in per update, at least one level
+
+	// Counters, as of the last update()
+	size_t residentBytes = 0;			// streamed textures' levels on the GPU
+	unsigned int pendingRequests = 0;	// textures still coarser than their draws asked for
+	unsigned int evictedLevels = 0;		// levels freed to stay within budget
+	unsigned int deferredLevels = 0;	// levels the budget had no room for, even after evicting
+
+	// Fraction of the budget in use, over 1 only if the levels no draw can do without are over it
+	float pressure() const { return budget > 0 ? (float)residentBytes / budget : 0.0f; }
+
+	// The texture for path, read here if nobody has done it yet, and streamed from then on
+	TextureHandle load(const std::string& path, TextureRole role)
+	{
+		bool created;
+		TextureHandle texture = TextureCache::instance().acquire(path, role, true, created);
+		if (!texture->loaded) {
+			EncodedImage image;
+			if (!loadEncodedImage(path, role, true, textureCompressionSupported(), image))
+				std::cout << "Texture failed to load at path: " << path << std::endl;
+			fill(texture, std::move(image));
+		}
+		return texture;
+	}
+
+	// Upload the small levels of a texture the cache created and take over its image to stream the rest from.
+	// Does nothing if someone else has filled the texture already.
+	void fill(const TextureHandle& texture, EncodedImage image, unsigned int pixelBuffer = 0)
+	{
+		if (texture->loaded)
+			return;
+		unsigned int first = 0;
+		while (first + 1 < image.levels.size() && std::max(image.width >> first, image.height >> first) > (int)initialSize)
+			first++;
+		TextureCache::instance().fill(*texture, image, pixelBuffer, first);
+		if (first == 0)
+			return;
+
+		texture->source = std::move(image);
+		texture->lastUsed = frame;
+		textures.push_back(texture);
+		residentBytes += texture->bytes;
+	}
+
+	// A draw is about to sample the texture with texCoordsPerPixel texture coordinates across a pixel, at its finest.
+	// Trilinear filtering reads level log2(texels per pixel) and the one above, so that level has to be resident.
+	void request(CachedTexture& texture, float texCoordsPerPixel)
+	{
+		if (texture.source.levels.empty())
+			return;
+		float texels = std::max(texture.source.width, texture.source.height) * texCoordsPerPixel;
+		unsigned int level = 0;
+		if (texels > 1.0f)
+			level = std::min((unsigned int)std::log2(texels), (unsigned int)texture.source.levels.size() - 1);
+		if (!texture.requested || level < texture.requestedLevel)
+			texture.requestedLevel = level;
+		texture.requested = true;
+		texture.lastUsed = frame;
+	}
+
+	// Stream in and evict for the draws since the last update. Call once a frame, before drawing.
+	void update()
+	{
+		// Drop textures nobody holds any more
+		textures.erase(std::remove_if(textures.begin(), textures.end(),
+			[](const std::weak_ptr<CachedTexture>& texture) { return texture.expired(); }), textures.end());
+
+		std::vector<TextureHandle> live;
+		live.reserve(textures.size());
+		residentBytes = 0;
+		for (const std::weak_ptr<CachedTexture>& texture : textures) {
+			live.push_back(texture.lock());
+			residentBytes += live.back()->bytes;
+		}
+
+		// Most undersampled first
+		std::vector<CachedTexture*> wanting;
+		for (const TextureHandle& texture : live) {
+			if (texture->requested && texture->requestedLevel < texture->residentLevel)
+				wanting.push_back(texture.get());
+		}
+		std::sort(wanting.begin(), wanting.end(), [](const CachedTexture* a, const CachedTexture* b) {
+			return a->residentLevel - a->requestedLevel > b->residentLevel - b->requestedLevel;
+		});
+
+		evictedLevels = 0;
+		deferredLevels = 0;
+		size_t uploaded = 0;
+		for (CachedTexture* texture : wanting) {
+			while (texture->residentLevel > texture->requestedLevel && (uploaded == 0 || uploaded < uploadBytesPerFrame)) {
+				size_t bytes = texture->source.levels[texture->residentLevel - 1].size();
+				if (residentBytes + bytes > budget && !evict(live, residentBytes + bytes - budget, texture)) {
+					deferredLevels++;
+					break;
+				}
+				streamTextureLevel(texture->id, texture->source, texture->residentLevel - 1);
+				texture->residentLevel--;
+				texture->bytes += bytes;
+				residentBytes += bytes;
+				uploaded += bytes;
+			}
+		}
+
+		pendingRequests = 0;
+		for (const TextureHandle& texture : live) {
+			if (texture->requested && texture->requestedLevel < texture->residentLevel)
+				pendingRequests++;
+			texture->requested = false;
+		}
+		frame++;
+	}
+
+private:
+	TextureStreamer() {}
+
+	// Free at least bytes by evicting levels no draw in the last frame needed, least recently used texture first,
+	// and among those used last frame the ones with more detail than was asked for. False if that isn't enough.
+	bool evict(const std::vector<TextureHandle>& live, size_t bytes, const CachedTexture* keep)
+	{
+		std::vector<CachedTexture*> candidates;
+		for (const TextureHandle& texture : live) {
+			if (texture.get() != keep && texture->residentLevel < floorLevel(*texture))
+				candidates.push_back(texture.get());
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const CachedTexture* a, const CachedTexture* b) {
+			return a->lastUsed < b->lastUsed;
+		});
+
+		size_t freed = 0;
+		for (CachedTexture* texture : candidates) {
+			while (freed < bytes && texture->residentLevel < floorLevel(*texture)) {
+				// Used last frame, it keeps the levels it asked for
+				if (texture->lastUsed == frame && (!texture->requested || texture->residentLevel >= texture->requestedLevel))
+					break;
+				size_t level = texture->source.levels[texture->residentLevel].size();
+				evictTextureLevel(texture->id, texture->residentLevel);
+				texture->residentLevel++;
+				texture->bytes -= level;
+				residentBytes -= level;
+				freed += level;
+				evictedLevels++;
+			}
+			if (freed >= bytes)
+				return true;
+		}
+		return false;
+	}
+
+	// Finest level fill() uploads, which stays resident
+	unsigned int floorLevel(const CachedTexture& texture) const
+	{
+		unsigned int level = 0;
+		while (level + 1 < texture.source.levels.size() && std::max(texture.source.width >> level, texture.source.height >> level) > (int)initialSize)
+			level++;
+		return level;
+	}
+
+	std::vector<std::weak_ptr<CachedTexture>> textures;
+	unsigned int frame = 0;
+};
+#endif
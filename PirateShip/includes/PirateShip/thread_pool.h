@@ -0,0 +1,179 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker has its own queue, takes its newest task first and steals the oldest task of others when idle.
+class ThreadPool
+{
+public:
+	// Workers in addition to the calling thread, which also runs tasks while it waits
+	explicit ThreadPool(unsigned int workerCount = defaultWorkerCount())
+	{
+		// One queue per worker plus one for whoever calls parallelFor
+		for (unsigned int i = 0; i < workerCount + 1; i++)
+			queues.push_back(std::unique_ptr<Queue>(new Queue()));
+
+		for (unsigned int i = 0; i < workerCount; i++)
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this, i + 1));
+	}
+
+	~ThreadPool() { stop(); }
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	static unsigned int defaultWorkerCount()
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 0;
+	}
+
+	// Threads that run tasks, including the caller
+	unsigned int threadCount() const { return (unsigned int)workers.size() + 1; }
+
+	// Run body(begin, end) over [0, count) in chunks of at most grainSize and wait for all of them
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+	{
+		if (count == 0)
+			return;
+		if (grainSize == 0)
+			grainSize = 1;
+
+		std::atomic<size_t> remaining((count + grainSize - 1) / grainSize);
+
+		// Deal the chunks out round-robin, idle workers steal to even out the load
+		unsigned int queue = 0;
+		for (size_t begin = 0; begin < count; begin += grainSize) {
+			size_t end = begin + grainSize < count ? begin + grainSize : count;
+			push(queue, [&body, &remaining, begin, end]() {
+				body(begin, end);
+				remaining--;
+			});
+			queue = (queue + 1) % queues.size();
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_all();
+
+		// Help out until every chunk has finished
+		while (remaining > 0) {
+			if (!runTask(0))
+				std::this_thread::yield();
+		}
+	}
+
+	// Let the workers run out of tasks and join them. Anything submitted afterwards runs on the caller.
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+
+	// Queue task for a worker and return without waiting for it. Runs it right here if there are no workers.
+	void submit(std::function<void()> task)
+	{
+		if (workers.empty()) {
+			task();
+			return;
+		}
+		push(1 + nextWorker++ % (unsigned int)workers.size(), std::move(task));
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_one();
+	}
+
+private:
+	typedef std::function<void()> Task;
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<size_t> queued{ 0 };
+	std::atomic<unsigned int> nextWorker{ 0 };
+	bool stopping = false;
+
+	void push(unsigned int queue, Task task)
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->tasks.push_back(std::move(task));
+		queued++;
+	}
+
+	// Run one task from our own queue, or one stolen from another, returns false if there was none
+	bool runTask(unsigned int home)
+	{
+		Task task;
+		if (!pop(home, task)) {
+			for (unsigned int i = 1; i < queues.size(); i++) {
+				if (steal((home + i) % queues.size(), task))
+					break;
+			}
+		}
+		if (!task)
+			return false;
+
+		task();
+		return true;
+	}
+
+	bool pop(unsigned int queue, Task& task)
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		if (queues[queue]->tasks.empty())
+			return false;
+		task = std::move(queues[queue]->tasks.back());
+		queues[queue]->tasks.pop_back();
+		queued--;
+		return true;
+	}
+
+	bool steal(unsigned int queue, Task& task)
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		if (queues[queue]->tasks.empty())
+			return false;
+		task = std::move(queues[queue]->tasks.front());
+		queues[queue]->tasks.pop_front();
+		queued--;
+		return true;
+	}
+
+	void workerLoop(unsigned int home)
+	{
+		while (true) {
+			if (runTask(home))
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this]() { return stopping || queued > 0; });
+			if (stopping)
+				return;
+		}
+	}
+};
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef TRIANGLE_BUFFER_H
+#define TRIANGLE_BUFFER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// A collision triangle with the data the narrow-phase needs precomputed
+struct CollisionTriangle {
+	glm::vec3 p1, p2, p3;
+	// p1 -> p2, p2 -> p3 and p3 -> p1
+	glm::vec3 edges[3];
+	// Unit normal of the triangle plane
+	glm::vec3 normal;
+	// Plane equation constant, so signed distance = dot(point, normal) + planeConstant
+	float planeConstant;
+	// Squared length of each edge
+	float edgeSquaredLengths[3];
+
+	// Computed exactly as Plane(p1, p2, p3) and Math::check_edges would
+	void set(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		p1 = a;
+		p2 = b;
+		p3 = c;
+		edges[0] = p2 - p1;
+		edges[1] = p3 - p2;
+		edges[2] = p1 - p3;
+		normal = glm::normalize(glm::cross(p2 - p1, p3 - p1));
+		planeConstant = -(normal.x * p1.x + normal.y * p1.y + normal.z * p1.z);
+		for (int i = 0; i < 3; i++)
+			edgeSquaredLengths[i] = glm::dot(edges[i], edges[i]);
+	}
+};
+
+// Contiguous, cache line aligned array of collision triangles.
+// Storage is only reallocated when it has to grow, so refilling it never touches the heap.
+class TriangleBuffer
+{
+public:
+	static const size_t cacheLineSize = 64;
+
+	TriangleBuffer() {}
+	~TriangleBuffer() { ::operator delete(memory); }
+
+	TriangleBuffer(const TriangleBuffer&) = delete;
+	TriangleBuffer& operator=(const TriangleBuffer&) = delete;
+
+	// Grow or shrink to count triangles, keeping existing ones
+	void resize(size_t newCount)
+	{
+		if (newCount > capacity)
+			reserve(newCount > 2 * capacity ? newCount : 2 * capacity);
+		count = newCount;
+	}
+
+	void reserve(size_t newCapacity)
+	{
+		if (newCapacity <= capacity)
+			return;
+
+		void* newMemory = ::operator new(newCapacity * sizeof(CollisionTriangle) + cacheLineSize);
+		CollisionTriangle* newData = (CollisionTriangle*)(((uintptr_t)newMemory + cacheLineSize - 1) & ~(uintptr_t)(cacheLineSize - 1));
+		if (count > 0)
+			std::memcpy(newData, data, count * sizeof(CollisionTriangle));
+
+		::operator delete(memory);
+		memory = newMemory;
+		data = newData;
+		capacity = newCapacity;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	CollisionTriangle& operator[](size_t i) { return data[i]; }
+	const CollisionTriangle& operator[](size_t i) const { return data[i]; }
+
+	CollisionTriangle* begin() { return data; }
+	CollisionTriangle* end() { return data + count; }
+	const CollisionTriangle* begin() const { return data; }
+	const CollisionTriangle* end() const { return data + count; }
+
+private:
+	void* memory = nullptr;
+	CollisionTriangle* data = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+};
+#endif
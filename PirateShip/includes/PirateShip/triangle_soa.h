@@ -0,0 +1,63 @@
+#pragma once
+#ifndef TRIANGLE_SOA_H
+#define TRIANGLE_SOA_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include <PirateShip/triangle_buffer.h>
+
+// Triangle vertices, planes and edges in structure-of-arrays layout so SIMD lanes can load one triangle each
+class TriangleSoA
+{
+public:
+	// components[vertex * 3 + axis][triangle]
+	std::vector<float> components[9];
+	// Precomputed plane of each triangle
+	std::vector<float> normals[3];
+	std::vector<float> planeConstants;
+	// Precomputed edges, edges[edge][axis][triangle] runs from vertex edge to the next, and their squared lengths
+	std::vector<float> edges[3][3];
+	std::vector<float> edgeSquaredLengths[3];
+
+	void resize(size_t count)
+	{
+		for (auto& component : components)
+			component.resize(count);
+		for (auto& normal : normals)
+			normal.resize(count);
+		planeConstants.resize(count);
+		for (int edge = 0; edge < 3; edge++) {
+			for (auto& axis : edges[edge])
+				axis.resize(count);
+			edgeSquaredLengths[edge].resize(count);
+		}
+	}
+
+	size_t size() const { return components[0].size(); }
+
+	void set(size_t index, const CollisionTriangle& triangle)
+	{
+		const glm::vec3* vertices[3] = { &triangle.p1, &triangle.p2, &triangle.p3 };
+		for (int vertex = 0; vertex < 3; vertex++) {
+			for (int axis = 0; axis < 3; axis++)
+				components[vertex * 3 + axis][index] = (*vertices[vertex])[axis];
+		}
+		for (int axis = 0; axis < 3; axis++)
+			normals[axis][index] = triangle.normal[axis];
+		planeConstants[index] = triangle.planeConstant;
+		for (int edge = 0; edge < 3; edge++) {
+			for (int axis = 0; axis < 3; axis++)
+				edges[edge][axis][index] = triangle.edges[edge][axis];
+			edgeSquaredLengths[edge][index] = triangle.edgeSquaredLengths[edge];
+		}
+	}
+
+	const float* component(int vertex, int axis) const { return components[vertex * 3 + axis].data(); }
+	const float* normal(int axis) const { return normals[axis].data(); }
+	const float* planeConstant() const { return planeConstants.data(); }
+	const float* edgeComponent(int edge, int axis) const { return edges[edge][axis].data(); }
+	const float* edgeSquaredLength(int edge) const { return edgeSquaredLengths[edge].data(); }
+};
+#endif
@@ -11,19 +11,24 @@
 #include <vector>
 
 #include <PirateShip/shader_m.h>
-#include <PirateShip/texture.h>
+#include <PirateShip/texture_cache.h>
 
 class WaterShader
 {
 public:
-	unsigned int _CloudTex1 = loadTexture("resources/plane/Clouds_01.jpg");
-	unsigned int _CloudTex2 = loadTexture("resources/plane/Waves.png");
-	unsigned int _FlowTex1 = loadTexture("resources/plane/Clouds_01_Flow.jpg");
-	unsigned int _ColorWaveTex = loadTexture("resources/plane/Waves_Color.jpg");
-
-	void setWaterShader(Shader& waterShader) 
+	// Upright, unlike the scene's other textures, so not shared with main's flipped copies of the same files
+	TextureHandle _CloudTex1 = loadTexture("resources/plane/Clouds_01.jpg", TEXTURE_COLOR, false);
+	TextureHandle _CloudTex2 = loadTexture("resources/plane/Waves.png", TEXTURE_COLOR, false);
+	TextureHandle _FlowTex1 = loadTexture("resources/plane/Clouds_01_Flow.jpg", TEXTURE_FLOW, false);
+	TextureHandle _ColorWaveTex = loadTexture("resources/plane/Waves_Color.jpg", TEXTURE_COLOR, false);
+
+	// Uses the shader. The settings never change and a program keeps its uniforms, so they are only set the first time.
+	void setWaterShader(Shader& waterShader)
 	{
 		waterShader.use();
+		if (waterShader.ID == configured)
+			return;
+		configured = waterShader.ID;
 
 		// Textures
 		waterShader.setInt("_CloudTex1", 0);
@@ -72,22 +77,23 @@ public:
 		waterShader.setFloat("_ColFactor", 20.0f);
 	}
 	
+	// The samplers were pointed at these units by setWaterShader
 	void bindWaterTextures(Shader& waterShader) {
+		(void)waterShader;
 		glActiveTexture(GL_TEXTURE0);
-		glUniform1i(glGetUniformLocation(waterShader.ID, "_CloudTex1"), 0);
-		glBindTexture(GL_TEXTURE_2D, _CloudTex1);
+		glBindTexture(GL_TEXTURE_2D, _CloudTex1->id);
 
 		glActiveTexture(GL_TEXTURE1);
-		glUniform1i(glGetUniformLocation(waterShader.ID, "_FlowTex1"), 1);
-		glBindTexture(GL_TEXTURE_2D, _FlowTex1);
+		glBindTexture(GL_TEXTURE_2D, _FlowTex1->id);
 
 		glActiveTexture(GL_TEXTURE2);
-		glUniform1i(glGetUniformLocation(waterShader.ID, "_CloudTex2"), 2);
-		glBindTexture(GL_TEXTURE_2D, _CloudTex2);
+		glBindTexture(GL_TEXTURE_2D, _CloudTex2->id);
 
 		glActiveTexture(GL_TEXTURE4);
-		glUniform1i(glGetUniformLocation(waterShader.ID, "_ColorTex"), 4);
-		glBindTexture(GL_TEXTURE_2D, _ColorWaveTex);
+		glBindTexture(GL_TEXTURE_2D, _ColorWaveTex->id);
 	}
+
+private:
+	GLuint configured = 0;
 };
 #endif
@@ -14,6 +14,15 @@
 #include <PirateShip/water_shader.h>
 #include <PirateShip/clouds_shader.h>
 #include <PirateShip/lighting_shader.h>
+#include <PirateShip/collision_world.h>
+#include <PirateShip/physics.h>
+#include <PirateShip/asset_loader.h>
+#include <PirateShip/frame_uniforms.h>
+#include <PirateShip/frustum_culler.h>
+#include <PirateShip/render_queue.h>
+#include <PirateShip/instance_buffer.h>
+#include <PirateShip/occlusion_query.h>
+#include <PirateShip/texture_streamer.h>
 
 #include <stb/stb_image.h>
 
@@ -22,15 +31,16 @@
 #include <assimp/postprocess.h>
 
 
+void runScene(GLFWwindow* window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void create_refraction_mask(Model& refractiveObject, Shader& refractiveShader, glm::vec3 translate, glm::vec3 scale);
-unsigned int loadTexture(const char* path);
+void create_refraction_mask(Model& refractiveObject, Shader& refractiveShader, const Uniform<glm::mat4>& modelUniform, glm::vec3 translate, glm::vec3 scale);
 
 void render_glass(
 	Model& refractiveObject,
 	Shader& refractiveShader,
+	const Uniform<glm::mat4>& modelUniform,
 	unsigned int& maskBuffer,
 	unsigned int& diffuseMap,
 	unsigned int& normalMap,
@@ -39,7 +49,8 @@ void render_glass(
 	glm::vec3 scale
 );
 
-std::vector<std::vector<glm::vec3>> getTriangles(const std::vector<Model>& hitboxes, const CollisionPackage& collisionPackage);
+std::vector<unsigned int> addHitboxes(CollisionWorld& world, const std::vector<const Model*>& hitboxes);
+void reportModels(const std::vector<const Model*>& models);
 
 
 const unsigned int SCR_WIDTH = 1920;
@@ -57,8 +68,14 @@ float lastFrame = 0.0f;
 
 // Player
 std::shared_ptr<CharacterEntity> entity;
+std::shared_ptr<CollisionWorld> collisionWorld;
+std::shared_ptr<PhysicsThread> physics;
 bool gravity = true;
 
+// Fleet of ships on the water, toggled with F
+bool showFleet = false;
+bool fleetKeyDown = false;
+
 
 int main() {
 	// glfw: initialize and configure
@@ -84,6 +101,16 @@ int main() {
 		return -1;
 	}
 
+	// Everything that owns GL objects lives in runScene, so it is released while the context still exists
+	runScene(window);
+
+	glfwTerminate();
+	return 0;
+}
+
+
+// Load the scene and run the render loop until the window closes
+void runScene(GLFWwindow* window) {
 	// z-buffer
 	glEnable(GL_DEPTH_TEST);
 
@@ -133,51 +160,98 @@ int main() {
 	// Load and generate the texture
 	int width, height, nrChannels;
 
-	// Flip y-axis of image
-	stbi_set_flip_vertically_on_load(true);
-
 	// Hide cursor and capture it
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	glfwSetCursorPosCallback(window, mouse_callback);
 
-	Model ourPlane("resources/plane/plane.obj");
-	Model ourCube("resources/cube/cube.obj");
-	Model ourDome("resources/dome/dome.obj");
-	Model ourPirateShip("resources/pirate_ship/pirateship.obj");
-	Model ourHitBox("resources/hitbox/hitbox.obj");
-	Model ourBottle("resources/bottle/bottle.obj");
-	Model ourSupport("resources/support/support.obj");
-
-	std::vector<Model> hitboxes = { ourHitBox };
-
-	// Flow shaders set up
-	unsigned int _CloudTex1 = loadTexture("resources/plane/Clouds_01.jpg");
-	unsigned int _CloudTex2 = loadTexture("resources/plane/Clouds_02.jpg");
-	unsigned int _FlowTex1 = loadTexture("resources/plane/Clouds_01_Flow.jpg");
-	unsigned int _WaveTex = loadTexture("resources/plane/Wave_Dist_1.jpg");
-	unsigned int _ColorTex = loadTexture("resources/plane/UpperColor.jpg");
-	unsigned int _ColorWaveTex = loadTexture("resources/plane/Waves_Color.jpg");
-	unsigned int _WaveTex2 = loadTexture("resources/plane/Waves.png");
+	// Read models and decode textures on worker threads, the render loop uploads them as they arrive
+	AssetLoader assets;
+	std::shared_ptr<Model> ourPlane = assets.loadModel("resources/plane/plane.obj");
+	std::shared_ptr<Model> ourCube = assets.loadModel("resources/cube/cube.obj");
+	std::shared_ptr<Model> ourDome = assets.loadModel("resources/dome/dome.obj");
+	std::shared_ptr<Model> ourPirateShip = assets.loadModel("resources/pirate_ship/pirateship.obj");
+	std::shared_ptr<Model> ourHitBox = assets.loadModel("resources/hitbox/hitbox.obj", KEEP_GEOMETRY);
+	std::shared_ptr<Model> ourBottle = assets.loadModel("resources/bottle/bottle.obj");
+	std::shared_ptr<Model> ourSupport = assets.loadModel("resources/support/support.obj");
+	std::vector<const Model*> models = { ourPlane.get(), ourCube.get(), ourDome.get(), ourPirateShip.get(), ourHitBox.get(), ourBottle.get(), ourSupport.get() };
+
+	// Flow shaders set up, images load flipped to GL's bottom-up rows
+	TextureHandle _CloudTex1 = assets.loadTexture("resources/plane/Clouds_01.jpg");
+	TextureHandle _CloudTex2 = assets.loadTexture("resources/plane/Clouds_02.jpg");
+	TextureHandle _FlowTex1 = assets.loadTexture("resources/plane/Clouds_01_Flow.jpg", TEXTURE_FLOW);
+	TextureHandle _WaveTex = assets.loadTexture("resources/plane/Wave_Dist_1.jpg");
+	TextureHandle _ColorTex = assets.loadTexture("resources/plane/UpperColor.jpg");
+	TextureHandle _ColorWaveTex = assets.loadTexture("resources/plane/Waves_Color.jpg");
+	TextureHandle _WaveTex2 = assets.loadTexture("resources/plane/Waves.png");
+
+	// A fleet of ships on the water, drawn with the draw calls of the one in the bottle
+	InstanceBuffer fleet;
+	const int fleetSize = 1000, fleetColumns = 40;
+	for (int i = 0; i < fleetSize; i++) {
+		InstanceData ship;
+		glm::vec3 position = glm::vec3((i % fleetColumns - fleetColumns / 2) * 150.0f, -10.0f, 300.0f + (i / fleetColumns) * 150.0f);
+		ship.model = glm::translate(glm::mat4(1.0f), position);
+		ship.model = glm::rotate(ship.model, glm::radians((float)(i * 37 % 360)), glm::vec3(0.0f, 1.0f, 0.0f));
+		ship.model = glm::scale(ship.model, glm::vec3(0.2f, 0.2f, 0.2f));
+		float shade = 0.75f + 0.25f * (i * 7 % 5) / 4.0f;
+		ship.material = glm::vec4(shade, shade, shade, 1.0f);
+		fleet.instances.push_back(ship);
+	}
+	fleet.upload();
 
 	// Glass shader set up
-	unsigned int _diffuseMap = loadTexture("resources/bottle/bottle_DIFF.jpg");
-	unsigned int _normalMap = loadTexture("resources/bottle/bottle_NORM.jpeg");
-	unsigned int _specularMap = loadTexture("resources/bottle/bottle_SPEC.png");
+	TextureHandle _diffuseMap = assets.loadTexture("resources/bottle/bottle_DIFF.jpg");
+	TextureHandle _normalMap = assets.loadTexture("resources/bottle/bottle_NORM.jpeg", TEXTURE_NORMAL);
+	TextureHandle _specularMap = assets.loadTexture("resources/bottle/bottle_SPEC.png", TEXTURE_MASK);
 
+	// The player collides with the hitbox from the first step, so it can't arrive late.
+	// Only the hitbox is read back after upload, the rest is render only
+	assets.wait(*ourHitBox);
+	std::vector<const Model*> hitboxes = { ourHitBox.get() };
+
+	// The glass's samplers never change, render_glass binds its textures to these units
 	refractiveShader.use();
-	refractiveShader.setInt("diffuseMap", 0);
-	refractiveShader.setInt("normalMap", 1);
-	refractiveShader.setInt("refractionMap", 2);
-	refractiveShader.setInt("environmentMap", 3);
-	refractiveShader.setInt("specularMap", 4);
+	refractiveShader.setInt("refractionMap", 0);
+	refractiveShader.setInt("diffuseMap", 1);
+	refractiveShader.setInt("normalMap", 2);
+	refractiveShader.setInt("specularMap", 3);
+
+	// Camera and lights come from uniform blocks written once a frame, only the model matrices are set per program
+	FrameUniforms frameUniforms;
+	FrameUniforms::attach(cloudsShader);
+	FrameUniforms::attach(waterShader);
+	FrameUniforms::attach(lightingShader);
+	FrameUniforms::attach(refractiveShader);
+	FrameUniforms::attach(refractiveMaskShader);
+	Uniform<glm::mat4> cloudsModel = cloudsShader.uniform<glm::mat4>("model");
+	Uniform<glm::mat4> waterModel = waterShader.uniform<glm::mat4>("model");
+	Uniform<glm::mat4> refractiveModel = refractiveShader.uniform<glm::mat4>("model");
+	Uniform<glm::mat4> refractiveMaskModel = refractiveMaskShader.uniform<glm::mat4>("model");
 
 	// Initialize player
 	entity = std::make_shared<CharacterEntity>();
 	entity->position[1] = 7.0f;
 	entity->position[2] = 4.0f;
-	entity->triangles = getTriangles(hitboxes, *entity->collisionPackage);
-	camera.setEntity(entity);
+	collisionWorld = std::make_shared<CollisionWorld>();
+	std::vector<unsigned int> hitboxHandles = addHitboxes(*collisionWorld, hitboxes);
+
+	// Adjust physical hitbox coordinates based on render coordinates
+	// (set once up front, the physics thread reads the world from here on)
+	glm::mat4 hitboxModel = glm::mat4(1.0f);
+	hitboxModel = glm::translate(hitboxModel, glm::vec3(0.0f, 5.0f, 0.0f));
+	hitboxModel = glm::scale(hitboxModel, glm::vec3(200, 200, 200));
+	for (unsigned int handle : hitboxHandles)
+		collisionWorld->setTransform(handle, hitboxModel);
+	collisionWorld->setRadius(entity->collisionPackage->eRadius);
+	collisionWorld->update();
+	entity->setWorld(collisionWorld);
+
+	// Step the player at a fixed rate on its own thread
+	physics = std::make_shared<PhysicsThread>(entity);
+	physics->setGravity(gravity);
+	camera.setPhysics(physics);
+	physics->start();
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ZERO);
@@ -214,9 +288,29 @@ int main() {
 
 	waterSettings.setWaterShader(waterShader);
 
+	FrustumCuller culler;
+	RenderQueue renderQueue;
+	OcclusionQuery bottleOcclusion;
+	float lastStatsTime = 0.0f;
+	bool firstFrame = true;
+	bool assetsReported = false;
+
 	// render loop
 	while (!glfwWindowShouldClose(window))
 	{
+		// Upload whatever the loader's workers have finished, a couple of milliseconds' worth per frame
+		assets.update();
+		// Stream in the texture levels last frame's draws asked for, within the VRAM budget
+		TextureStreamer::instance().update();
+		if (!assetsReported && assets.idle()) {
+			assetsReported = true;
+			std::cout << "All assets loaded after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+			reportModels(models);
+			TextureCache& textures = TextureCache::instance();
+			std::cout << "Textures: " << textures.size() << " for " << textures.requests << " requests, " << textures.loadedBytes / 1024 << " KB uploaded ("
+				<< textures.uncompressedBytes / 1024 << " KB uncompressed), " << textures.savedBytes / 1024 << " KB saved by sharing" << std::endl;
+		}
+
 		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 		glEnable(GL_DEPTH_TEST);
 
@@ -229,10 +323,8 @@ int main() {
 
 		processInput(window);
 
-		// Update player and camera
-		entity->update(gravity);
-		camera.Position = entity->position;
-		entity->velocity = entity->velocity * .05f;
+		// Camera follows the player, interpolated between the last two physics steps
+		camera.Position = physics->interpolatedPosition();
 
 		// Clear buffers
 		glClearColor(25.0f/255.0f, 25.0f/ 255.0f, 112.0f/ 255.0f, 1.0f);
@@ -240,6 +332,38 @@ int main() {
 
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
 		glm::mat4 view = camera.GetViewMatrix();
+		LodView lodView = LodView::perspective(camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+		DrawStats::frame() = DrawStats();
+		UniformStats::frame() = UniformStats();
+
+		// Everything the programs share this frame, one buffer update
+		frameUniforms.camera.projection = projection;
+		frameUniforms.camera.view = view;
+		frameUniforms.camera.viewPos = camera.Position;
+		frameUniforms.camera.time = currentFrame;
+		frameUniforms.lights = lightingSettings.lights();
+		frameUniforms.update();
+
+		// Where the lit models are drawn this frame
+		glm::mat4 shipModel = glm::mat4(1.0f);
+		shipModel = glm::translate(shipModel, glm::vec3(0.0f, 5.0f, 0.0f));
+		shipModel = glm::scale(shipModel, glm::vec3(0.02, 0.02, 0.02));
+
+		// Bottle scale and translation
+		glm::vec3 bottle_translate = glm::vec3(0.0f, 25.5f, 0.0f);
+		glm::vec3 bottle_scale = glm::vec3(15.0f, 15.0f, 15.0f);
+		glm::mat4 bottleModel = glm::scale(glm::translate(glm::mat4(1.0f), bottle_translate), bottle_scale);
+
+		glm::mat4 supportModel = glm::mat4(1.0f);
+		supportModel = glm::translate(supportModel, glm::vec3(0.0f, -3.95f, 5.0f));
+		supportModel = glm::scale(supportModel, bottle_scale);
+
+		// Skip the meshes outside the view, culled together before anything draws
+		culler.begin(projection, view);
+		culler.add(*ourPirateShip, shipModel);
+		culler.add(*ourSupport, supportModel);
+		culler.add(*ourBottle, bottleModel);
+		culler.cull();
 
 		// Ignore depth buffer when rendering skybox
 		glDepthMask(GL_FALSE);
@@ -250,17 +374,13 @@ int main() {
 		model = glm::scale(model, glm::vec3(200.0f, 200.0f, 200.0f));
 		
 		cloudsShader.use();
-		cloudsShader.setMat4("projection", projection);
-		cloudsShader.setMat4("view", view);
-		cloudsShader.setMat4("model", model);
-		cloudsShader.setVec3("viewPos", camera.Position);
-		cloudsShader.setFloat("_Time", glfwGetTime());
+		cloudsModel.set(model);
 
 		cloudsSettings.setCloudsShader(cloudsShader);
-		cloudsSettings.bindCloudsTextures(cloudsShader, _CloudTex1, _FlowTex1, 
-										  _CloudTex2, _WaveTex, _ColorTex);
+		cloudsSettings.bindCloudsTextures(cloudsShader, _CloudTex1->id, _FlowTex1->id, 
+										  _CloudTex2->id, _WaveTex->id, _ColorTex->id);
 
-		ourDome.Draw2(cloudsShader);
+		ourDome->Draw2(cloudsShader);
 
 		glClear(GL_DEPTH_BUFFER_BIT);
 		glDepthMask(GL_TRUE);
@@ -271,78 +391,60 @@ int main() {
 		model = glm::scale(model, glm::vec3(10000.0f, 10000.0f, 10000.0f));
 		
 		waterShader.use();
-		waterShader.setMat4("projection", projection);
-		waterShader.setMat4("view", view);
-		waterShader.setMat4("model", model);
-		waterShader.setVec3("viewPos", camera.Position);
-		waterShader.setFloat("_Time", glfwGetTime());
+		waterModel.set(model);
 
 		waterSettings.setWaterShader(waterShader);
 		waterSettings.bindWaterTextures(waterShader);
 
-		ourPlane.Draw2(waterShader);
+		ourPlane->Draw2(waterShader);
 
 		// Render objects with general lighting shader
 		lightingShader.use();
 		lightingSettings.setLightingShader(lightingShader);
 
 		// Render ship
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 5.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.02, 0.02, 0.02));
-		lightingShader.setMat4("projection", projection);
-		lightingShader.setMat4("view", view);
-		lightingShader.setMat4("model", model);
-		lightingShader.setMat4("model", model);
-		lightingShader.setVec3("viewPos", camera.Position);
+		model = shipModel;
 
-		ourPirateShip.Draw(lightingShader);
+		// The lit models are queued and drawn together, sorted so shared materials and vertex arrays are bound once
+		ourPirateShip->queue(renderQueue, lightingShader, lodView, model);
 
-		// Change hitbox size
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 5.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(200, 200, 200));
+		if (showFleet)
+			ourPirateShip->queueInstanced(renderQueue, lightingShader, fleet, lodView);
 
 		// Render the hitbox for debugging
-		//lightingShader.setMat4("model", model);
-		//ourHitBox.Draw(lightingShader);
-
-		// Adjust physical hitbox coordinates based on render coordinates
-		entity->triangles = getTriangles(hitboxes, *entity->collisionPackage);
-		for (auto& triangle : entity->triangles) {
-			glm::vec4 first = glm::vec4(triangle[0], 1);
-			glm::vec4 second = glm::vec4(triangle[1], 1);
-			glm::vec4 third = glm::vec4(triangle[2], 1);
-			first = model * first;
-			second = model * second;
-			third = model * third;
-			triangle = { glm::vec3(first), glm::vec3(second), glm::vec3(third) };
-		}
-
-		// Bottle scale and translation
-		glm::vec3 bottle_translate = glm::vec3(0.0f, 25.5f, 0.0f);
-		glm::vec3 bottle_scale = glm::vec3(15.0f, 15.0f, 15.0f);
+		//lightingShader.setMat4("model", hitboxModel);
+		//ourHitBox->Draw(lightingShader);
 
 		// Render wood bottle support
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, -3.95f, 5.0f));
-		model = glm::scale(model, bottle_scale);
+		model = supportModel;
+		ourSupport->queue(renderQueue, lightingShader, lodView, model);
 
-		lightingShader.setMat4("model", model);
-		ourSupport.Draw(lightingShader);
+		renderQueue.flush();
 
-		// Render glass bottle
-		create_refraction_mask(ourBottle, refractiveMaskShader, bottle_translate, bottle_scale);
+		// The glass passes only run if the bottle is in view and its box wasn't hidden behind the ship.
+		// The box is tested against everything drawn so far, the answer comes from an earlier frame's test.
+		bool drawGlass = false;
+		if (ourBottle->visibleMeshes() > 0) {
+			bottleOcclusion.test(lightCubeShader, projection, view, camera.Position, ourBottle->bounds().transformed(bottleModel), 1.0f);
+			drawGlass = bottleOcclusion.visible();
+		}
+		else
+			bottleOcclusion.reset();
 
-		// Swap framebuffer textures
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
-		
-		// Clear the buffer for drawing the bottle
-		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		if (drawGlass) {
+			// Render glass bottle
+			create_refraction_mask(*ourBottle, refractiveMaskShader, refractiveMaskModel, bottle_translate, bottle_scale);
 
-		render_glass(ourBottle, refractiveShader, maskBuffer, _diffuseMap, 
-					 _normalMap, _specularMap, bottle_translate, bottle_scale);
+			// Swap framebuffer textures
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+			// Clear the buffer for drawing the bottle
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			render_glass(*ourBottle, refractiveShader, refractiveModel, maskBuffer, _diffuseMap->id, 
+						 _normalMap->id, _specularMap->id, bottle_translate, bottle_scale);
+		}
 
 		// Bind back to default framebuffer and draw a quad plane with the attached framebuffer color texture
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -361,16 +463,38 @@ int main() {
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 
 		// Draw the refractive object
-		glBindTexture(GL_TEXTURE_2D, colorTexture);	
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		if (drawGlass) {
+			glBindTexture(GL_TEXTURE_2D, colorTexture);	
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+
+		// Triangles, draw calls and culling this frame and texture streaming, in the title about once a second
+		if (currentFrame - lastStatsTime >= 1.0f) {
+			lastStatsTime = currentFrame;
+			TextureStreamer& streamer = TextureStreamer::instance();
+			std::string title = "LearnOpenGL | " + std::to_string(DrawStats::frame().triangles) + " triangles, " +
+				std::to_string(DrawStats::frame().fullTriangles) + " at full detail, " + std::to_string(DrawStats::frame().drawCalls) + " draw calls, " +
+				std::to_string(culler.submitted) + " meshes submitted, " + std::to_string(culler.culled) + " culled, " +
+				std::to_string(renderQueue.programChanges) + "/" + std::to_string(renderQueue.materialChanges) + "/" +
+				std::to_string(renderQueue.vertexArrayChanges) + " program/material/VAO binds, " +
+				std::to_string(UniformStats::frame().lookups) + " uniform lookups, " + std::to_string(frameUniforms.stalls) + " uniform buffer stalls | textures " +
+				std::to_string(streamer.residentBytes / 1024) + " KB, " + std::to_string((int)(streamer.pressure() * 100.0f)) + "% of budget, " +
+				std::to_string(streamer.pendingRequests) + " streaming" + (drawGlass ? "" : " | glass skipped");
+			glfwSetWindowTitle(window, title.c_str());
+		}
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		// glfwGetTime counts from glfwInit
+		if (firstFrame) {
+			firstFrame = false;
+			std::cout << "First frame after " << glfwGetTime() * 1000.0 << " ms, " << assets.pending() << " assets still loading" << std::endl;
+		}
 	}
 
-	glfwTerminate();
-	return 0;
+	physics->stop();
 }
 
 
@@ -385,8 +509,15 @@ void processInput(GLFWwindow* window)
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
 		gravity = !gravity;
+		physics->setGravity(gravity);
+	}
+
+	bool fleetKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+	if (fleetKey && !fleetKeyDown)
+		showFleet = !showFleet;
+	fleetKeyDown = fleetKey;
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -419,37 +550,50 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 }
 
 
-// Convert all the triangles of a hitbox into ellipsoid space and put them in an array for collision
-std::vector<std::vector<glm::vec3>> getTriangles(const std::vector<Model>& hitboxes, const CollisionPackage& collisionPackage) {
-	std::vector<std::vector<glm::vec3>> triangles;
+// Where the models came from and what their geometry costs
+void reportModels(const std::vector<const Model*>& models) {
+	int cachedModels = 0;
+	size_t vertexBytes = 0, fullVertexBytes = 0, loadedGeometryBytes = 0, keptGeometryBytes = 0;
+	for (const Model* model : models) {
+		cachedModels += model->fromCache ? 1 : 0;
+		vertexBytes += model->batch.bufferSize();
+		loadedGeometryBytes += model->loadedGeometryBytes;
+		keptGeometryBytes += model->geometryBytes();
+		for (const Mesh& mesh : model->meshes) {
+			vertexBytes += mesh.vertexBufferSize;
+			fullVertexBytes += mesh.vertexCount * sizeof(Vertex);
+		}
+	}
+	std::cout << cachedModels << " of " << models.size() << " models from the mesh cache ("
+		<< (cachedModels == (int)models.size() ? "warm" : "cold") << " start)" << std::endl;
+	std::cout << "Model draws: " << (GeometryBatch::supported() ? "multi-draw indirect (GL 4.3)" : "one per mesh (GL 3.3)") << std::endl;
+	std::cout << "Vertex buffers: " << vertexBytes / 1024 << " KB, " << fullVertexBytes / 1024 << " KB with the full Vertex" << std::endl;
+	std::cout << "CPU geometry: " << loadedGeometryBytes / 1024 << " KB loaded, " << keptGeometryBytes / 1024 << " KB kept after upload" << std::endl;
+}
+
 
-	for (const auto& hitbox : hitboxes) {
-		for (const auto& mesh : hitbox.meshes) {
-			for (int i = 0; i < mesh.indices.size();) {
-				// Get indices of a triangle's vertices
-				int a = mesh.indices[i++];
-				int b = mesh.indices[i++];
-				int c = mesh.indices[i++];
+// Hand the triangles of every hitbox mesh to the collision world, which keeps them in ellipsoid space
+std::vector<unsigned int> addHitboxes(CollisionWorld& world, const std::vector<const Model*>& hitboxes) {
+	std::vector<unsigned int> handles;
 
-				// Three coordinates of a triangle in ellipsoid space
-				glm::vec3 first = mesh.vertices[a].Position / collisionPackage.eRadius;
-				glm::vec3 second = mesh.vertices[b].Position / collisionPackage.eRadius;
-				glm::vec3 third = mesh.vertices[c].Position / collisionPackage.eRadius;
+	for (const Model* hitbox : hitboxes) {
+		for (const auto& mesh : hitbox->meshes) {
+			std::vector<glm::vec3> positions;
+			positions.reserve(mesh.vertices.size());
+			for (const auto& vertex : mesh.vertices)
+				positions.push_back(vertex.Position);
 
-				std::vector<glm::vec3> triangle = { first, second, third };
-			
-				triangles.push_back(triangle);
-			}
+			handles.push_back(world.addHitbox(positions, mesh.indices));
 		}
 	}
 
-	return triangles;
+	return handles;
 }
 
 
 // Create a mask by rendering the refractive object to the framebuffer's alpha channel
 // Other objects in front will cut away from the mask and won't show up in refraction
-void create_refraction_mask(Model& refractiveObject, Shader& refractiveShader, glm::vec3 translate, glm::vec3 scale) {
+void create_refraction_mask(Model& refractiveObject, Shader& refractiveShader, const Uniform<glm::mat4>& modelUniform, glm::vec3 translate, glm::vec3 scale) {
 	// Write to the alpha channel
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
 
@@ -457,17 +601,13 @@ void create_refraction_mask(Model& refractiveObject, Shader& refractiveShader, g
 	glDepthMask(GL_FALSE);
 
 	// Set up shader
-	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-	glm::mat4 view = camera.GetViewMatrix();
 	glm::mat4 model = glm::mat4(1.0f);
 
 	model = glm::translate(model, translate);
 	model = glm::scale(model, scale);
 
 	refractiveShader.use();
-	refractiveShader.setMat4("projection", projection);
-	refractiveShader.setMat4("view", view);
-	refractiveShader.setMat4("model", model);
+	modelUniform.set(model);
 
 	// Draw refractive object
 	refractiveObject.Draw2(refractiveShader);
@@ -484,6 +624,7 @@ void create_refraction_mask(Model& refractiveObject, Shader& refractiveShader, g
 void render_glass(
 	Model& refractiveObject, 
 	Shader& refractiveShader, 
+	const Uniform<glm::mat4>& modelUniform,
 	unsigned int& maskBuffer,
 	unsigned int& diffuseMap,
 	unsigned int& normalMap,
@@ -495,44 +636,31 @@ void render_glass(
 	refractiveShader.use();
 
 	// Set up shader
-	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-	glm::mat4 view = camera.GetViewMatrix();
 	glm::mat4 model = glm::mat4(1.0f);
 
 	model = glm::translate(model, translate);
 	model = glm::scale(model, scale);
 
 	refractiveShader.use();
-	refractiveShader.setMat4("projection", projection);
-	refractiveShader.setMat4("view", view);
-	refractiveShader.setMat4("model", model);
-	refractiveShader.setVec3("vCameraPos", camera.Position);
+	modelUniform.set(model);
 
 	// Set background texture
 	// What's behind the object
 	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(glGetUniformLocation(refractiveShader.ID, "refractionMap"), 0);
 	glBindTexture(GL_TEXTURE_2D, maskBuffer);
 
 	// Set diffuse map
 	glActiveTexture(GL_TEXTURE1);
-	glUniform1i(glGetUniformLocation(refractiveShader.ID, "diffuseMap"), 1);
 	glBindTexture(GL_TEXTURE_2D, diffuseMap);
 
 	// Set normal map
 	glActiveTexture(GL_TEXTURE2);
-	glUniform1i(glGetUniformLocation(refractiveShader.ID, "normalMap"), 2);
 	glBindTexture(GL_TEXTURE_2D, normalMap);
 
 	// Set specular map
 	glActiveTexture(GL_TEXTURE3);
-	glUniform1i(glGetUniformLocation(refractiveShader.ID, "specularMap"), 3);
 	glBindTexture(GL_TEXTURE_2D, specularMap);
 
-	// Directional light
-	refractiveShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-	refractiveShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
 	// Draw refractive object
 	refractiveObject.Draw2(refractiveShader);
 }
@@ -48,10 +48,15 @@ uniform float _Speed;
 uniform float _ColPow;
 uniform float _ColFactor;
 
-uniform float _Time;
+// per frame, shared by every program
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float _Time;
+};
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 
 void main()
 {
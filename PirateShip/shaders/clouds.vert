@@ -7,8 +7,14 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per frame, shared by every program
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float _Time;
+};
+
 uniform mat4 model;
 
 void main()
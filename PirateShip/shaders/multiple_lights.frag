@@ -15,15 +15,14 @@ struct DirLight {
     vec3 specular;
 };
 
+// the attenuation terms fill the std140 padding after each vec3
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
@@ -51,10 +50,22 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in vec4 InstanceMaterial;
+
+// per frame, shared by every program
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float _Time;
+};
+
+// the scene's lights, shared by every lit program
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+};
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotLight;
 uniform Material material;
 
@@ -100,9 +111,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)) * InstanceMaterial.rgb;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords)) * InstanceMaterial.rgb;
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords)) * InstanceMaterial.a;
     return (ambient + diffuse + specular);
 }
 
@@ -119,9 +130,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)) * InstanceMaterial.rgb;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords)) * InstanceMaterial.rgb;
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords)) * InstanceMaterial.a;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -145,9 +156,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)) * InstanceMaterial.rgb;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords)) * InstanceMaterial.rgb;
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords)) * InstanceMaterial.a;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -2,20 +2,35 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per instance, read by instanced draws instead of the model uniform
+layout (location = 7) in mat4 aInstanceModel;
+layout (location = 11) in vec4 aInstanceMaterial;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec4 InstanceMaterial;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per frame, shared by every program
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float _Time;
+};
+
+uniform bool instanced;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    mat4 world = instanced ? aInstanceModel : model;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(world))) * aNormal;  
     TexCoords = aTexCoords;
+    // diffuse tint in rgb, specular scale in a
+    InstanceMaterial = instanced ? aInstanceMaterial : vec4(1.0);
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
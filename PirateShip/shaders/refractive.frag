@@ -16,6 +16,19 @@ struct DirLight {
     vec3 specular;
 };
 
+// the attenuation terms fill the std140 padding after each vec3
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+#define NR_POINT_LIGHTS 4
+
 float fresnel(vec3 light, vec3 normal, float R0);
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 
@@ -28,13 +41,19 @@ uniform sampler2D normalMap;
 uniform sampler2D refractionMap;
 uniform sampler2D specularMap;
 
-uniform DirLight dirLight;
+// the scene's lights, shared by every lit program
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+};
 
 void main() {
     vec3 vEye = normalize(fs_in.Eye.xyz);
 
     // Get bump and apply scale, then get diffuse
     vec4 vBumpTex = 2.0 * texture(normalMap, fs_in.BaseUV.xy) - 1.0;
+    // The normal map is BC5, which only stores x and y, so rebuild z from the unit length
+    vBumpTex.z = sqrt(max(1.0 - dot(vBumpTex.xy, vBumpTex.xy), 0.0));
     vec3 vBump = normalize(vBumpTex.xyz * vec3(0.2, 0.2, 1.0));
     vec4 vDiffuse = texture(diffuseMap, fs_in.BaseUV.xy);
 
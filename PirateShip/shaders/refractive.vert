@@ -4,12 +4,17 @@ layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec2 TexCoords;
 layout (location = 3) in vec3 Tangent;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per frame, shared by every program
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float _Time;
+};
+
 uniform mat4 model;
 
 uniform vec4 vTranslation = vec4(0);
-uniform vec3 vCameraPos;
 
 out VS_OUT {
     vec2 BaseUV;
@@ -36,7 +41,7 @@ mat3 GetTangentSpaceBasis(vec3 T, vec3 N)
 void main() {
     FragPos = vec3(model * vec4(Pos, 1.0));
     aNormal = mat3(transpose(inverse(model))) * Normal;
-    CameraPos = vCameraPos;
+    CameraPos = viewPos;
 
     mat4 MVP = projection * view * model;
     
@@ -51,14 +56,14 @@ void main() {
         
     // get tangent space basis    
     mat3 objToTangentSpace = GetTangentSpaceBasis(Tangent.xyz, Normal.xyz);
-    vec3 EyeVec = vCameraPos.xyz - vPos.xyz;
+    vec3 EyeVec = viewPos.xyz - vPos.xyz;
     vs_out.Eye.xyz = objToTangentSpace * EyeVec;
 
     // Fresnel R value
     vec3 posWorld = (model *  vHPos).xyz;
 	vec3 normWorld = normalize((model * vec4(Normal, 1)).xyz);
 
-	vec3 I = normalize(posWorld - vCameraPos);
+	vec3 I = normalize(posWorld - viewPos);
     float _Bias = 0.1;
     float _Scale = 0.01;
     float _Power = 0.05;
@@ -44,7 +44,13 @@ uniform float _CloudDensity;
 uniform float _Scale;
 uniform float _Speed;
 
-uniform float _Time;
+// per frame, shared by every program
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float _Time;
+};
 
 uniform DirLight dirLight;
 
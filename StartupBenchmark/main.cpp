@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <PirateShip/mesh_cache.h>
+#include <PirateShip/mesh_loader.h>
+#include <PirateShip/mesh_optimizer.h>
+
+// Headless cold and warm start timings of every model the game loads.
+// Cold: no mesh cache, Assimp imports the model and the cache is written. Warm: the cache is memory mapped.
+//
+// Then the post-transform vertex cache stats of every mesh, in file order against the optimised order the cache stores.
+//
+// StartupBenchmark [resource root]   (defaults to ../PirateShip/, the game's working directory)
+
+const char* models[] = {
+	"resources/plane/plane.obj",
+	"resources/cube/cube.obj",
+	"resources/dome/dome.obj",
+	"resources/pirate_ship/pirateship.obj",
+	"resources/hitbox/hitbox.obj",
+	"resources/bottle/bottle.obj",
+	"resources/support/support.obj",
+};
+
+bool sameMeshes(const std::vector<MeshData>& a, const std::vector<MeshData>& b);
+void reportVertexCache(const std::string& root);
+
+
+int main(int argc, char** argv)
+{
+	// Warm loads are quick enough to be noisy, keep the best of a few
+	const int warmRuns = 5;
+	std::string root = argc > 1 ? argv[1] : "../PirateShip/";
+	if (!root.empty() && root.back() != '/')
+		root += '/';
+
+	std::cout << std::setw(40) << std::left << "model" << std::right
+		<< std::setw(12) << "vertices"
+		<< std::setw(12) << "cold ms"
+		<< std::setw(12) << "warm ms"
+		<< std::setw(12) << "speedup"
+		<< std::setw(10) << "same" << std::endl;
+
+	double coldTotal = 0.0, warmTotal = 0.0;
+	bool allSame = true;
+
+	for (const char* model : models) {
+		std::string path = root + model;
+		remove(MeshCache::cachePath(path).c_str());
+
+		std::vector<MeshData> cold;
+		bool fromCache = false;
+		auto start = std::chrono::high_resolution_clock::now();
+		bool loaded = MeshLoader::load(path, cold, &fromCache);
+		auto end = std::chrono::high_resolution_clock::now();
+		if (!loaded) {
+			std::cout << "ERROR::STARTUP::LOAD_FAILED " << path << std::endl;
+			return 1;
+		}
+		double coldMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+		std::vector<MeshData> warm;
+		double warmMs = 0.0;
+		for (int run = 0; run < warmRuns; run++) {
+			warm.clear();
+			start = std::chrono::high_resolution_clock::now();
+			MeshLoader::load(path, warm, &fromCache);
+			end = std::chrono::high_resolution_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			if (run == 0 || ms < warmMs)
+				warmMs = ms;
+		}
+
+		bool same = fromCache && sameMeshes(cold, warm);
+		allSame = allSame && same;
+		coldTotal += coldMs;
+		warmTotal += warmMs;
+
+		size_t vertices = 0;
+		for (const MeshData& mesh : cold)
+			vertices += mesh.vertices.size();
+
+		std::cout << std::setw(40) << std::left << model << std::right
+			<< std::setw(12) << vertices
+			<< std::setw(12) << std::fixed << std::setprecision(2) << coldMs
+			<< std::setw(12) << warmMs
+			<< std::setw(12) << std::setprecision(1) << coldMs / warmMs
+			<< std::setw(10) << (same ? "yes" : "NO") << std::endl;
+	}
+
+	std::cout << std::setw(40) << std::left << "total" << std::right
+		<< std::setw(12) << ""
+		<< std::setw(12) << std::setprecision(2) << coldTotal
+		<< std::setw(12) << warmTotal
+		<< std::setw(12) << std::setprecision(1) << coldTotal / warmTotal << std::endl;
+
+	reportVertexCache(root);
+	return allSame ? 0 : 1;
+}
+
+
+// Byte for byte, the cache must hand back exactly what Assimp produced
+bool sameMeshes(const std::vector<MeshData>& a, const std::vector<MeshData>& b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].vertices.size() != b[i].vertices.size() ||
+			a[i].indices != b[i].indices ||
+			a[i].lodIndices != b[i].lodIndices ||
+			a[i].lods.size() != b[i].lods.size() ||
+			a[i].textures.size() != b[i].textures.size())
+			return false;
+		if (memcmp(a[i].vertices.data(), b[i].vertices.data(), a[i].vertices.size() * sizeof(Vertex)) != 0 ||
+			memcmp(a[i].lods.data(), b[i].lods.data(), a[i].lods.size() * sizeof(MeshLod)) != 0)
+			return false;
+		for (size_t t = 0; t < a[i].textures.size(); t++) {
+			if (a[i].textures[t].type != b[i].textures[t].type || a[i].textures[t].path != b[i].textures[t].path)
+				return false;
+		}
+	}
+	return true;
+}
+
+
+// ACMR and ATVR of each mesh as Assimp returns it and after MeshOptimizer, with a FIFO the size of MeshOptimizer::cacheSize
+void reportVertexCache(const std::string& root)
+{
+	std::cout << std::endl << "vertex cache, FIFO of " << (unsigned int)MeshOptimizer::cacheSize << std::endl;
+	std::cout << std::setw(40) << std::left << "model" << std::right
+		<< std::setw(6) << "mesh"
+		<< std::setw(12) << "triangles"
+		<< std::setw(12) << "ACMR file"
+		<< std::setw(12) << "ACMR opt"
+		<< std::setw(12) << "ATVR file"
+		<< std::setw(12) << "ATVR opt" << std::endl;
+
+	for (const char* model : models) {
+		std::string path = root + model;
+		std::vector<MeshData> original, optimized;
+		if (!MeshLoader::import(path, original, false) || !MeshLoader::load(path, optimized) || original.size() != optimized.size())
+			continue;
+
+		unsigned int triangles = 0, transformedBefore = 0, transformedAfter = 0;
+		for (size_t i = 0; i < original.size(); i++) {
+			VertexCacheStats before = MeshOptimizer::analyze(original[i].indices, original[i].vertices.size());
+			VertexCacheStats after = MeshOptimizer::analyze(optimized[i].indices, optimized[i].vertices.size());
+			triangles += (unsigned int)original[i].indices.size() / 3;
+			transformedBefore += before.transformed;
+			transformedAfter += after.transformed;
+			std::cout << std::setw(40) << std::left << model << std::right
+				<< std::setw(6) << i
+				<< std::setw(12) << original[i].indices.size() / 3
+				<< std::setw(12) << std::setprecision(3) << before.acmr
+				<< std::setw(12) << after.acmr
+				<< std::setw(12) << before.atvr
+				<< std::setw(12) << after.atvr << std::endl;
+		}
+		if (triangles > 0)
+			std::cout << std::setw(40) << std::left << model << std::right
+				<< std::setw(6) << "all"
+				<< std::setw(12) << triangles
+				<< std::setw(12) << (float)transformedBefore / triangles
+				<< std::setw(12) << (float)transformedAfter / triangles
+				<< std::setw(24) << std::setprecision(1) << 100.0f * (1.0f - (float)transformedAfter / transformedBefore) << "% fewer" << std::endl;
+	}
+}